@@ -664,7 +664,7 @@ void  SHPWriteHeader(SHPHandle psSHP)
 /*                              SHPOpen()                               */
 /************************************************************************/
 
-SHPHandle  SHPOpenSHPOpen(const char *pszLayer, const char *pszAccess)
+SHPHandle  SHPOpen(const char *pszLayer, const char *pszAccess)
 {
     SAHooks sHooks;
 
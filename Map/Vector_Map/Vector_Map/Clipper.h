@@ -0,0 +1,454 @@
+#ifndef VECTORMAP_CLIPPER_H
+#define VECTORMAP_CLIPPER_H
+
+#include "Layer.h"
+#include "Geometry.h"
+#include "JobSystem.h"
+#include "Validate.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+#define CLIP_FEATURES_PER_JOB 64        // Features overlaid per job
+
+//------------------------------------------------------------------------------------
+// Clipper - boolean operations on polygons
+//
+// Both inputs are cleaned and rewound first (outer rings clockwise, holes counter-
+// clockwise), so every boundary edge has its polygon's interior on the right. An edge
+// sweep sorted by x finds every crossing and every vertex touching an edge of the other
+// polygon, with exact orientation signs (Orient2DSign), and edges are cut there.
+// Identical pieces of both polygons merge into one undirected edge. For each piece the
+// inside/outside state of both polygons is known on its left and right: from the edge's
+// own direction when it belongs to that polygon, from a point in polygon test of its
+// midpoint otherwise. A piece is kept when the operation gives different answers on
+// the two sides, directed so the result lies on its right, which yields the shapefile
+// orientation for free. Kept pieces are chained into rings, taking the sharpest right
+// turn where several leave a vertex so rings touching at a point come out separate.
+//------------------------------------------------------------------------------------
+typedef enum {
+    CLIP_INTERSECTION = 0,      // Inside both
+    CLIP_UNION,                 // Inside either
+    CLIP_DIFFERENCE,            // Inside the subject, outside the clip polygon
+    CLIP_XOR                    // Inside exactly one
+} ClipOperation;
+
+typedef struct ClipEdge {
+    double ax, ay, bx, by;
+    int source;                 // 0 subject, 1 clip polygon
+    int next;                   // Following edge of the same ring
+} ClipEdge;
+
+typedef struct ClipSplit {
+    int edge;
+    double t;                   // Position along the edge, 0..1
+    double x, y;
+    bool crossing;              // Proper crossing, otherwise the other input touches here
+} ClipSplit;
+
+typedef struct ClipPiece {
+    int from, to;               // Vertex ids, from < to
+    int direction[2];           // Per input: +1 along from->to, -1 against, 0 not on its boundary
+    bool inside[2];             // Per input not on its boundary: the piece lies inside it
+} ClipPiece;
+
+typedef struct ClipVertexKey {
+    double x, y;
+    bool operator==(const ClipVertexKey &other) const { return x == other.x && y == other.y; }
+} ClipVertexKey;
+
+typedef struct ClipVertexHash {
+    size_t operator()(const ClipVertexKey &key) const
+    {
+        unsigned long long bx, by;
+        memcpy(&bx, &key.x, sizeof(bx));
+        memcpy(&by, &key.y, sizeof(by));
+        return (size_t)(bx*0x9E3779B97F4A7C15ull ^ (by + 0x632BE59BD9B4E019ull + (bx << 6) + (bx >> 2)));
+    }
+} ClipVertexHash;
+
+inline bool ClipInside(ClipOperation operation, bool a, bool b)
+{
+    switch (operation)
+    {
+        case CLIP_INTERSECTION: return a && b;
+        case CLIP_UNION: return a || b;
+        case CLIP_DIFFERENCE: return a && !b;
+        default: return a != b;
+    }
+}
+
+// Open copies of the rings of a polygon feature
+inline void FeatureRings(const Layer &layer, int feature, std::vector<PartPoints> *rings)
+{
+    rings->clear();
+    for (int p = layer.featurePart[feature]; p < layer.featurePart[feature + 1]; p++)
+    {
+        int start = layer.partStart[p], end = layer.partStart[p + 1];
+        if (end - start > 1 && layer.x[start] == layer.x[end - 1] && layer.y[start] == layer.y[end - 1]) end--;
+
+        PartPoints ring;
+        ring.x.assign(layer.x.begin() + start, layer.x.begin() + end);
+        ring.y.assign(layer.y.begin() + start, layer.y.begin() + end);
+        rings->push_back(ring);
+    }
+}
+
+// Even-odd test over open rings
+inline bool RingsContainPoint(const std::vector<PartPoints> &rings, double x, double y)
+{
+    bool inside = false;
+    for (int r = 0; r < (int)rings.size(); r++)
+    {
+        if (PointInRing(rings[r].x.data(), rings[r].y.data(), (int)rings[r].x.size(), x, y)) inside = !inside;
+    }
+    return inside;
+}
+
+inline Bounds RingsBounds(const std::vector<PartPoints> &rings)
+{
+    Bounds b = EmptyBounds();
+    for (int r = 0; r < (int)rings.size(); r++)
+    {
+        for (int v = 0; v < (int)rings[r].x.size(); v++) BoundsExtend(&b, rings[r].x[v], rings[r].y[v]);
+    }
+    return b;
+}
+
+inline double ClipEdgeParameter(const ClipEdge &edge, double x, double y)
+{
+    double dx = edge.bx - edge.ax, dy = edge.by - edge.ay;
+    return ((x - edge.ax)*dx + (y - edge.ay)*dy)/(dx*dx + dy*dy);
+}
+
+// Record where edges i and j of different inputs cross or touch. 'touched' flags the
+// ring vertices (by the edge starting there) lying on the other input's boundary.
+inline void ClipIntersectEdges(const std::vector<ClipEdge> &edges, int i, int j, std::vector<ClipSplit> *splits, std::vector<char> *touched)
+{
+    const ClipEdge &e = edges[i], &f = edges[j];
+    int o1 = Orient2DSign(e.ax, e.ay, e.bx, e.by, f.ax, f.ay);
+    int o2 = Orient2DSign(e.ax, e.ay, e.bx, e.by, f.bx, f.by);
+    int o3 = Orient2DSign(f.ax, f.ay, f.bx, f.by, e.ax, e.ay);
+    int o4 = Orient2DSign(f.ax, f.ay, f.bx, f.by, e.bx, e.by);
+
+    if (o1*o2 < 0 && o3*o4 < 0)
+    {
+        double d3 = Orient2D(f.ax, f.ay, f.bx, f.by, e.ax, e.ay), d4 = Orient2D(f.ax, f.ay, f.bx, f.by, e.bx, e.by);
+        double t = d3/(d3 - d4);
+        double x = e.ax + t*(e.bx - e.ax), y = e.ay + t*(e.by - e.ay);
+        ClipSplit a = { i, t, x, y, true }, b = { j, ClipEdgeParameter(f, x, y), x, y, true };
+        splits->push_back(a);
+        splits->push_back(b);
+        return;
+    }
+
+    // Touching and collinear overlap: an endpoint of one lies inside the other edge
+    if (o1 == 0 && OnSegment(e.ax, e.ay, e.bx, e.by, f.ax, f.ay))
+    {
+        ClipSplit s = { i, ClipEdgeParameter(e, f.ax, f.ay), f.ax, f.ay, false };
+        splits->push_back(s);
+        (*touched)[j] = 1;
+    }
+    if (o2 == 0 && OnSegment(e.ax, e.ay, e.bx, e.by, f.bx, f.by))
+    {
+        ClipSplit s = { i, ClipEdgeParameter(e, f.bx, f.by), f.bx, f.by, false };
+        splits->push_back(s);
+        (*touched)[f.next] = 1;
+    }
+    if (o3 == 0 && OnSegment(f.ax, f.ay, f.bx, f.by, e.ax, e.ay))
+    {
+        ClipSplit s = { j, ClipEdgeParameter(f, e.ax, e.ay), e.ax, e.ay, false };
+        splits->push_back(s);
+        (*touched)[i] = 1;
+    }
+    if (o4 == 0 && OnSegment(f.ax, f.ay, f.bx, f.by, e.bx, e.by))
+    {
+        ClipSplit s = { j, ClipEdgeParameter(f, e.bx, e.by), e.bx, e.by, false };
+        splits->push_back(s);
+        (*touched)[e.next] = 1;
+    }
+}
+
+// Boolean operation of two polygons given as rings (open or closed, any orientation).
+// 'result' receives closed rings, outer rings clockwise and holes counter-clockwise.
+inline void ClipRings(const std::vector<PartPoints> &subject, const std::vector<PartPoints> &clip, ClipOperation operation, std::vector<PartPoints> *result)
+{
+    result->clear();
+
+    std::vector<PartPoints> inputs[2];
+    ValidationStats scratch = EmptyValidationStats();
+    for (int s = 0; s < 2; s++)
+    {
+        const std::vector<PartPoints> &rings = (s == 0) ? subject : clip;
+        for (int r = 0; r < (int)rings.size(); r++)
+        {
+            PartPoints ring = rings[r];
+            CleanPart(&ring, true, &scratch);
+            if (ring.x.size() >= 3) inputs[s].push_back(ring);
+        }
+        RewindRings(&inputs[s]);
+    }
+
+    // Disjoint inputs need no sweep
+    Bounds bounds[2] = { RingsBounds(inputs[0]), RingsBounds(inputs[1]) };
+    if (inputs[0].empty() || inputs[1].empty() || !BoundsIntersect(bounds[0], bounds[1]))
+    {
+        if (operation != CLIP_INTERSECTION) result->insert(result->end(), inputs[0].begin(), inputs[0].end());
+        if (operation == CLIP_UNION || operation == CLIP_XOR) result->insert(result->end(), inputs[1].begin(), inputs[1].end());
+        for (int r = 0; r < (int)result->size(); r++)
+        {
+            (*result)[r].x.push_back((*result)[r].x[0]);
+            (*result)[r].y.push_back((*result)[r].y[0]);
+        }
+        return;
+    }
+
+    std::vector<ClipEdge> edges;
+    for (int s = 0; s < 2; s++)
+    {
+        for (int r = 0; r < (int)inputs[s].size(); r++)
+        {
+            const PartPoints &ring = inputs[s][r];
+            int n = (int)ring.x.size();
+            for (int i = 0; i < n; i++)
+            {
+                int first = (int)edges.size() - i;
+                ClipEdge edge = { ring.x[i], ring.y[i], ring.x[(i + 1)%n], ring.y[(i + 1)%n], s, (i + 1 < n) ? first + i + 1 : first };
+                edges.push_back(edge);
+            }
+        }
+    }
+
+    // Sweep by left end with one active list per input, so an edge is only tested
+    // against the active edges of the other input
+    std::vector<int> order(edges.size());
+    for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&edges](int a, int b) {
+        return fmin(edges[a].ax, edges[a].bx) < fmin(edges[b].ax, edges[b].bx);
+    });
+
+    std::vector<ClipSplit> splits;
+    std::vector<char> touched(edges.size(), 0);
+    std::vector<int> active[2];
+    for (int k = 0; k < (int)order.size(); k++)
+    {
+        int e = order[k];
+        const ClipEdge &edge = edges[e];
+        double left = fmin(edge.ax, edge.bx), minY = fmin(edge.ay, edge.by), maxY = fmax(edge.ay, edge.by);
+        std::vector<int> &others = active[1 - edge.source];
+
+        int kept = 0;
+        for (int m = 0; m < (int)others.size(); m++)
+        {
+            const ClipEdge &other = edges[others[m]];
+            if (fmax(other.ax, other.bx) < left) continue;
+            others[kept++] = others[m];
+            if (fmax(other.ay, other.by) < minY || fmin(other.ay, other.by) > maxY) continue;
+            ClipIntersectEdges(edges, e, others[m], &splits, &touched);
+        }
+        others.resize(kept);
+        active[edge.source].push_back(e);
+    }
+
+    std::sort(splits.begin(), splits.end(), [](const ClipSplit &a, const ClipSplit &b) {
+        return (a.edge < b.edge) || (a.edge == b.edge && a.t < b.t);
+    });
+
+    // Cut edges into pieces over shared vertex ids, merging pieces both inputs have
+    std::unordered_map<ClipVertexKey, int, ClipVertexHash> vertexIds;
+    std::vector<double> vx, vy;
+    auto vertexId = [&](double x, double y) {
+        ClipVertexKey key = { x + 0.0, y + 0.0 };
+        std::pair<std::unordered_map<ClipVertexKey, int, ClipVertexHash>::iterator, bool> it = vertexIds.insert(std::make_pair(key, (int)vx.size()));
+        if (it.second)
+        {
+            vx.push_back(key.x);
+            vy.push_back(key.y);
+        }
+        return it.first->second;
+    };
+
+    std::unordered_map<unsigned long long, int> pieceIds;
+    std::vector<ClipPiece> pieces;
+    auto addPiece = [&](int from, int to, int source, bool inside) {
+        if (from == to) return;
+        int lo = (from < to) ? from : to, hi = (from < to) ? to : from;
+        unsigned long long key = ((unsigned long long)lo << 32) | (unsigned long long)hi;
+        std::pair<std::unordered_map<unsigned long long, int>::iterator, bool> it = pieceIds.insert(std::make_pair(key, (int)pieces.size()));
+        if (it.second)
+        {
+            ClipPiece piece = { lo, hi, { 0, 0 }, { false, false } };
+            pieces.push_back(piece);
+        }
+        pieces[it.first->second].direction[source] += (from == lo) ? 1 : -1;
+        pieces[it.first->second].inside[1 - source] = inside;
+    };
+
+    // Walking a ring, the state of the other input only changes at a proper crossing; it
+    // is tested again (point in polygon at the piece midpoint) at the ring start and
+    // wherever the other boundary touches the ring
+    bool inside = false, unknown = true;
+    for (int e = 0, s = 0; e < (int)edges.size(); e++)
+    {
+        const ClipEdge &edge = edges[e];
+        if (e == 0 || edges[e - 1].next != e || touched[e]) unknown = true;
+
+        int previous = vertexId(edge.ax, edge.ay);
+        for (; s < (int)splits.size() && splits[s].edge == e; s++)
+        {
+            if (splits[s].t <= 0.0 || splits[s].t >= 1.0)
+            {
+                unknown = true;
+                continue;
+            }
+            int next = vertexId(splits[s].x, splits[s].y);
+            if (next != previous)
+            {
+                if (unknown) inside = RingsContainPoint(inputs[1 - edge.source], 0.5*(vx[previous] + vx[next]), 0.5*(vy[previous] + vy[next]));
+                unknown = false;
+                addPiece(previous, next, edge.source, inside);
+            }
+            if (splits[s].crossing) inside = !inside;
+            else unknown = true;
+            previous = next;
+        }
+
+        int last = vertexId(edge.bx, edge.by);
+        if (last != previous)
+        {
+            if (unknown) inside = RingsContainPoint(inputs[1 - edge.source], 0.5*(vx[previous] + vx[last]), 0.5*(vy[previous] + vy[last]));
+            unknown = false;
+            addPiece(previous, last, edge.source, inside);
+        }
+    }
+
+    // Keep pieces whose two sides differ in the result, directed with the result on the right
+    std::vector<int> from, to;
+    for (int p = 0; p < (int)pieces.size(); p++)
+    {
+        const ClipPiece &piece = pieces[p];
+        bool right[2], left[2];
+        for (int s = 0; s < 2; s++)
+        {
+            if (piece.direction[s] != 0)
+            {
+                right[s] = piece.direction[s] > 0;
+                left[s] = !right[s];
+            }
+            else right[s] = left[s] = piece.inside[s];
+        }
+
+        bool inRight = ClipInside(operation, right[0], right[1]);
+        bool inLeft = ClipInside(operation, left[0], left[1]);
+        if (inRight == inLeft) continue;
+        from.push_back(inRight ? piece.from : piece.to);
+        to.push_back(inRight ? piece.to : piece.from);
+    }
+
+    // Outgoing pieces per vertex
+    int vertexCount = (int)vx.size(), keptCount = (int)from.size();
+    std::vector<int> firstOut(vertexCount + 1, 0), outgoing(keptCount);
+    for (int k = 0; k < keptCount; k++) firstOut[from[k] + 1]++;
+    for (int v = 0; v < vertexCount; v++) firstOut[v + 1] += firstOut[v];
+    std::vector<int> fill(firstOut.begin(), firstOut.end() - 1);
+    for (int k = 0; k < keptCount; k++) outgoing[fill[from[k]]++] = k;
+
+    std::vector<char> used(keptCount, 0);
+    for (int start = 0; start < keptCount; start++)
+    {
+        if (used[start]) continue;
+
+        PartPoints ring;
+        int current = start;
+        while (current >= 0 && !used[current])
+        {
+            used[current] = 1;
+            ring.x.push_back(vx[from[current]]);
+            ring.y.push_back(vy[from[current]]);
+
+            int v = to[current];
+            if (v == from[start]) break;
+
+            // Sharpest right turn relative to the incoming direction
+            double dx = vx[v] - vx[from[current]], dy = vy[v] - vy[from[current]];
+            int best = -1;
+            double bestAngle = 0.0;
+            for (int o = firstOut[v]; o < firstOut[v + 1]; o++)
+            {
+                int k = outgoing[o];
+                if (used[k]) continue;
+                double ox = vx[to[k]] - vx[v], oy = vy[to[k]] - vy[v];
+                double angle = atan2(dx*oy - dy*ox, dx*ox + dy*oy);
+                if (best < 0 || angle < bestAngle)
+                {
+                    best = k;
+                    bestAngle = angle;
+                }
+            }
+            current = best;
+        }
+
+        CleanPart(&ring, true, &scratch);
+        if (ring.x.size() < 3) continue;
+        ring.x.push_back(ring.x[0]);
+        ring.y.push_back(ring.y[0]);
+        result->push_back(ring);
+    }
+}
+
+// Boolean operation of two polygon features, possibly from different layers
+inline void ClipFeatures(const Layer &a, int fa, const Layer &b, int fb, ClipOperation operation, std::vector<PartPoints> *result)
+{
+    std::vector<PartPoints> subject, clip;
+    FeatureRings(a, fa, &subject);
+    FeatureRings(b, fb, &clip);
+    ClipRings(subject, clip, operation, result);
+}
+
+// Every feature of a polygon layer combined with one polygon, e.g. a study area or a
+// tile. Features keep their index and columns, an emptied feature has no parts.
+inline Layer OverlayLayer(const Layer &layer, const std::vector<PartPoints> &clip, ClipOperation operation, JobSystem *jobs)
+{
+    int count = layer.featureCount;
+    std::vector<std::vector<PartPoints>> features(count);
+    Bounds clipBounds = RingsBounds(clip);
+
+    auto body = [&](int first, int last) {
+        std::vector<PartPoints> rings;
+        for (int f = first; f < last; f++)
+        {
+            FeatureRings(layer, f, &rings);
+
+            // Features clear of the clip polygon are either dropped or kept as they are
+            if (!BoundsIntersect(layer.featureBounds[f], clipBounds) && operation != CLIP_UNION)
+            {
+                if (operation == CLIP_INTERSECTION) continue;
+                std::vector<PartPoints> empty;
+                ClipRings(rings, empty, CLIP_DIFFERENCE, &features[f]);
+                continue;
+            }
+            ClipRings(rings, clip, operation, &features[f]);
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, count, CLIP_FEATURES_PER_JOB, body);
+    else body(0, count);
+
+    return BuildLayerFromParts(layer.shapeType, features, layer.columns);
+}
+
+// All features of a polygon layer merged into one polygon
+inline void DissolveLayer(const Layer &layer, std::vector<PartPoints> *result)
+{
+    std::vector<PartPoints> rings, merged;
+    result->clear();
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        FeatureRings(layer, f, &rings);
+        ClipRings(*result, rings, CLIP_UNION, &merged);
+        result->swap(merged);
+    }
+}
+
+#endif // VECTORMAP_CLIPPER_H
@@ -0,0 +1,115 @@
+#ifndef VECTORMAP_DELAUNAY_H
+#define VECTORMAP_DELAUNAY_H
+
+#include "Geometry.h"
+#include <vector>
+#include <algorithm>
+
+#define DELAUNAY_INCIRCLE_EPSILON 1e-12     // Relative incircle margin, closer to cocircular is left as is
+
+//------------------------------------------------------------------------------------
+// Delaunay - constrained Delaunay refinement of a polygon triangulation
+//
+// Lawson's flip algorithm: an edge shared by two triangles whose opposite vertex lies
+// inside the other triangle's circumcircle is replaced by the other diagonal of their
+// quad, and the four outer edges are checked again. Edges with a triangle on one side
+// only are the polygon rings and are never flipped, so starting from any triangulation
+// of the polygon (the ear clipper's) the flips end at its constrained Delaunay
+// triangulation, which maximizes the smallest angle and removes the ear clipper's fans
+// of slivers. Near-cocircular quads within DELAUNAY_INCIRCLE_EPSILON are not flipped,
+// which keeps the loop finite in floating point.
+//------------------------------------------------------------------------------------
+
+inline int DelaunayNext(int h)
+{
+    return (h%3 == 2) ? h - 2 : h + 1;
+}
+
+inline int DelaunayPrev(int h)
+{
+    return (h%3 == 0) ? h + 2 : h - 1;
+}
+
+inline void DelaunayLink(std::vector<int> *twin, int a, int b)
+{
+    if (a >= 0) (*twin)[a] = b;
+    if (b >= 0) (*twin)[b] = a;
+}
+
+// Flip the counter-clockwise triangles indices[first..] into the constrained Delaunay
+// triangulation of the region they cover. Triangles keep their count and winding.
+inline void DelaunayFlipTriangles(const double *x, const double *y, std::vector<unsigned int> *indices, size_t first)
+{
+    int halfEdges = (int)(indices->size() - first);
+    if (halfEdges < 6) return;
+    unsigned int *v = indices->data() + first;
+
+    // Pair every half-edge a -> b with b -> a through buckets on the lower vertex id. An
+    // edge present twice in one direction (bridges, touching rings) is left unpaired and
+    // so stays fixed.
+    unsigned int lo = v[0], hi = v[0];
+    for (int h = 1; h < halfEdges; h++)
+    {
+        if (v[h] < lo) lo = v[h];
+        if (v[h] > hi) hi = v[h];
+    }
+    std::vector<int> bucketStart(hi - lo + 2, 0), bucket(halfEdges);
+    for (int h = 0; h < halfEdges; h++) bucketStart[std::min(v[h], v[DelaunayNext(h)]) - lo + 1]++;
+    for (unsigned int i = 0; i <= hi - lo; i++) bucketStart[i + 1] += bucketStart[i];
+    std::vector<int> cursor(bucketStart.begin(), bucketStart.end() - 1);
+    for (int h = 0; h < halfEdges; h++) bucket[cursor[std::min(v[h], v[DelaunayNext(h)]) - lo]++] = h;
+
+    std::vector<int> twin(halfEdges, -1), stack;
+    for (int h = 0; h < halfEdges; h++)
+    {
+        unsigned int a = v[h], b = v[DelaunayNext(h)], key = std::min(a, b) - lo;
+        int same = 0, opposite = -1, opposites = 0;
+        for (int k = bucketStart[key]; k < bucketStart[key + 1]; k++)
+        {
+            int g = bucket[k];
+            if (g == h) continue;
+            if (v[g] == a && v[DelaunayNext(g)] == b) same++;
+            else if (v[g] == b && v[DelaunayNext(g)] == a)
+            {
+                opposite = g;
+                opposites++;
+            }
+        }
+        if (same > 0 || opposites != 1) continue;
+        twin[h] = opposite;
+        if (h < opposite) stack.push_back(h);
+    }
+
+    while (!stack.empty())
+    {
+        int h = stack.back();
+        stack.pop_back();
+        int g = twin[h];
+        if (g < 0) continue;
+
+        // Triangles (a, b, c) and (b, a, d) across a -> b
+        unsigned int a = v[h], b = v[DelaunayNext(h)], c = v[DelaunayPrev(h)], d = v[DelaunayPrev(g)];
+        if (Orient2DSign(x[a], y[a], x[d], y[d], x[c], y[c]) <= 0 || Orient2DSign(x[b], y[b], x[c], y[c], x[d], y[d]) <= 0) continue;
+        double magnitude;
+        if (InCircle(x[a], y[a], x[b], y[b], x[c], y[c], x[d], y[d], &magnitude) <= DELAUNAY_INCIRCLE_EPSILON*magnitude) continue;
+
+        // Becomes (a, d, c) and (b, c, d) across c -> d
+        int t = h - h%3, u = g - g%3;
+        int bc = twin[DelaunayNext(h)], ca = twin[DelaunayPrev(h)];
+        int ad = twin[DelaunayNext(g)], db = twin[DelaunayPrev(g)];
+        v[t] = a; v[t + 1] = d; v[t + 2] = c;
+        v[u] = b; v[u + 1] = c; v[u + 2] = d;
+        DelaunayLink(&twin, t, ad);
+        DelaunayLink(&twin, t + 1, u + 1);
+        DelaunayLink(&twin, t + 2, ca);
+        DelaunayLink(&twin, u, bc);
+        DelaunayLink(&twin, u + 2, db);
+
+        stack.push_back(t);
+        stack.push_back(t + 2);
+        stack.push_back(u);
+        stack.push_back(u + 2);
+    }
+}
+
+#endif // VECTORMAP_DELAUNAY_H
@@ -0,0 +1,301 @@
+#ifndef VECTORMAP_GEOMETRY_H
+#define VECTORMAP_GEOMETRY_H
+
+#include "Layer.h"
+
+//------------------------------------------------------------------------------------
+// Exact geometry predicates on layer features
+//------------------------------------------------------------------------------------
+
+// Squared distance from (px, py) to the segment (ax, ay)-(bx, by)
+inline double PointSegmentDistanceSq(double px, double py, double ax, double ay, double bx, double by)
+{
+    double dx = bx - ax;
+    double dy = by - ay;
+    double t = 0.0;
+    double len = dx*dx + dy*dy;
+
+    if (len > 0.0)
+    {
+        t = ((px - ax)*dx + (py - ay)*dy)/len;
+        if (t < 0.0) t = 0.0;
+        else if (t > 1.0) t = 1.0;
+    }
+
+    double ex = ax + t*dx - px;
+    double ey = ay + t*dy - py;
+    return ex*ex + ey*ey;
+}
+
+// Twice the signed area of the triangle a, b, c: positive when c lies left of a->b
+inline double Orient2D(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    return (bx - ax)*(cy - ay) - (by - ay)*(cx - ax);
+}
+
+// Positive when d lies inside the circle through the counter-clockwise a, b, c, negative
+// outside, zero on it. *magnitude receives the permanent of the determinant, the scale
+// its rounding error is relative to.
+inline double InCircle(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy, double *magnitude)
+{
+    double adx = ax - dx, ady = ay - dy;
+    double bdx = bx - dx, bdy = by - dy;
+    double cdx = cx - dx, cdy = cy - dy;
+    double alift = adx*adx + ady*ady;
+    double blift = bdx*bdx + bdy*bdy;
+    double clift = cdx*cdx + cdy*cdy;
+
+    *magnitude = (fabs(bdx*cdy) + fabs(cdx*bdy))*alift + (fabs(cdx*ady) + fabs(adx*cdy))*blift + (fabs(adx*bdy) + fabs(bdx*ady))*clift;
+    return alift*(bdx*cdy - cdx*bdy) + blift*(cdx*ady - adx*cdy) + clift*(adx*bdy - bdx*ady);
+}
+
+// Error-free transformations: a + b == *s + *e and a - b == *s + *e exactly
+inline void TwoSum(double a, double b, double *s, double *e)
+{
+    *s = a + b;
+    double bv = *s - a;
+    double av = *s - bv;
+    *e = (a - av) + (b - bv);
+}
+
+inline void TwoDiff(double a, double b, double *s, double *e)
+{
+    *s = a - b;
+    double bv = a - *s;
+    double av = *s + bv;
+    *e = (a - av) + (bv - b);
+}
+
+// Exact sign of Orient2D: -1, 0 or 1. The double determinant decides when it is larger
+// than its rounding error bound (almost always); otherwise the differences and products
+// are split into exact two-term pairs and the 16 terms are summed as a floating point
+// expansion (Shewchuk), whose largest component carries the sign.
+inline int Orient2DSign(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    double left = (bx - ax)*(cy - ay);
+    double right = (by - ay)*(cx - ax);
+    double det = left - right;
+    double bound = (3.0 + 16.0*DBL_EPSILON)*DBL_EPSILON*0.5*(fabs(left) + fabs(right));
+    if (det > bound) return 1;
+    if (-det > bound) return -1;
+
+    double d[4][2];
+    TwoDiff(bx, ax, &d[0][0], &d[0][1]);
+    TwoDiff(cy, ay, &d[1][0], &d[1][1]);
+    TwoDiff(by, ay, &d[2][0], &d[2][1]);
+    TwoDiff(cx, ax, &d[3][0], &d[3][1]);
+
+    double terms[16];
+    int count = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            double p = d[0][i]*d[1][j];
+            terms[count++] = p;
+            terms[count++] = fma(d[0][i], d[1][j], -p);
+            double q = d[2][i]*d[3][j];
+            terms[count++] = -q;
+            terms[count++] = -fma(d[2][i], d[3][j], -q);
+        }
+    }
+
+    // Grow-Expansion with zero elimination, components stay in increasing magnitude
+    double expansion[17];
+    int length = 0;
+    for (int t = 0; t < count; t++)
+    {
+        double q = terms[t];
+        int kept = 0;
+        for (int k = 0; k < length; k++)
+        {
+            double h;
+            TwoSum(q, expansion[k], &q, &h);
+            if (h != 0.0) expansion[kept++] = h;
+        }
+        if (q != 0.0) expansion[kept++] = q;
+        length = kept;
+    }
+
+    if (length == 0) return 0;
+    return (expansion[length - 1] > 0.0) ? 1 : -1;
+}
+
+// c is known to be collinear with a-b, test whether it lies within the segment box
+inline bool OnSegment(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    return cx >= fmin(ax, bx) && cx <= fmax(ax, bx) && cy >= fmin(ay, by) && cy <= fmax(ay, by);
+}
+
+// Closed segment intersection test on exact orientations, touching and collinear overlap
+// count as intersecting. Degenerate segments (a == b) behave as points.
+inline bool SegmentsIntersect(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy)
+{
+    int d1 = Orient2DSign(cx, cy, dx, dy, ax, ay);
+    int d2 = Orient2DSign(cx, cy, dx, dy, bx, by);
+    int d3 = Orient2DSign(ax, ay, bx, by, cx, cy);
+    int d4 = Orient2DSign(ax, ay, bx, by, dx, dy);
+
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) return true;
+
+    if (d1 == 0 && OnSegment(cx, cy, dx, dy, ax, ay)) return true;
+    if (d2 == 0 && OnSegment(cx, cy, dx, dy, bx, by)) return true;
+    if (d3 == 0 && OnSegment(ax, ay, bx, by, cx, cy)) return true;
+    if (d4 == 0 && OnSegment(ax, ay, bx, by, dx, dy)) return true;
+
+    return false;
+}
+
+// Crossing-number test of one ring, the ring may or may not repeat its first vertex
+inline bool PointInRing(const double *xs, const double *ys, int count, double px, double py)
+{
+    bool inside = false;
+
+    for (int i = 0, j = count - 1; i < count; j = i++)
+    {
+        if (((ys[i] > py) != (ys[j] > py)) &&
+            (px < (xs[j] - xs[i])*(py - ys[i])/(ys[j] - ys[i]) + xs[i])) inside = !inside;
+    }
+
+    return inside;
+}
+
+// Even-odd test over every ring of a polygon feature, so holes and multi-part records are handled
+inline bool FeatureContainsPoint(const Layer &layer, int feature, double px, double py)
+{
+    if (!IsPolygonType(layer.shapeType)) return false;
+    if (!BoundsContainsPoint(layer.featureBounds[feature], px, py)) return false;
+
+    bool inside = false;
+
+    for (int p = layer.featurePart[feature]; p < layer.featurePart[feature + 1]; p++)
+    {
+        int start = layer.partStart[p];
+        int count = layer.partStart[p + 1] - start;
+        if (PointInRing(&layer.x[start], &layer.y[start], count, px, py)) inside = !inside;
+    }
+
+    return inside;
+}
+
+// Squared distance from a point to the feature geometry: vertices for point layers,
+// segments for lines and polygon boundaries, zero inside a polygon
+inline double FeatureDistanceSq(const Layer &layer, int feature, double px, double py)
+{
+    double best = DBL_MAX;
+
+    if (FeatureContainsPoint(layer, feature, px, py)) return 0.0;
+
+    for (int p = layer.featurePart[feature]; p < layer.featurePart[feature + 1]; p++)
+    {
+        int start = layer.partStart[p];
+        int end = layer.partStart[p + 1];
+
+        if (end - start == 1)
+        {
+            double dx = layer.x[start] - px;
+            double dy = layer.y[start] - py;
+            if (dx*dx + dy*dy < best) best = dx*dx + dy*dy;
+            continue;
+        }
+
+        for (int v = start; v < end - 1; v++)
+        {
+            double d = PointSegmentDistanceSq(px, py, layer.x[v], layer.y[v], layer.x[v + 1], layer.y[v + 1]);
+            if (d < best) best = d;
+        }
+    }
+
+    return best;
+}
+
+// Exact intersection test between two features of possibly different layers: any pair of
+// segments (single-vertex parts act as points) touching, or one feature lying inside a
+// polygon of the other
+inline bool FeaturesIntersect(const Layer &a, int fa, const Layer &b, int fb)
+{
+    const Bounds &ba = a.featureBounds[fa];
+    const Bounds &bb = b.featureBounds[fb];
+    if (BoundsIsEmpty(ba) || BoundsIsEmpty(bb) || !BoundsIntersect(ba, bb)) return false;
+
+    for (int pa = a.featurePart[fa]; pa < a.featurePart[fa + 1]; pa++)
+    {
+        int aStart = a.partStart[pa];
+        int aLast = (a.partStart[pa + 1] - aStart > 1) ? a.partStart[pa + 1] - 1 : aStart + 1;
+
+        for (int va = aStart; va < aLast; va++)
+        {
+            int na = (a.partStart[pa + 1] - aStart > 1) ? va + 1 : va;
+            double ax = a.x[va], ay = a.y[va], bx = a.x[na], by = a.y[na];
+            Bounds segment = { fmin(ax, bx), fmin(ay, by), fmax(ax, bx), fmax(ay, by) };
+            if (!BoundsIntersect(segment, bb)) continue;
+
+            for (int pb = b.featurePart[fb]; pb < b.featurePart[fb + 1]; pb++)
+            {
+                int bStart = b.partStart[pb];
+                int bLast = (b.partStart[pb + 1] - bStart > 1) ? b.partStart[pb + 1] - 1 : bStart + 1;
+
+                for (int vb = bStart; vb < bLast; vb++)
+                {
+                    int nb = (b.partStart[pb + 1] - bStart > 1) ? vb + 1 : vb;
+                    double cx = b.x[vb], cy = b.y[vb], dx = b.x[nb], dy = b.y[nb];
+                    if (fmax(cx, dx) < segment.minX || fmin(cx, dx) > segment.maxX ||
+                        fmax(cy, dy) < segment.minY || fmin(cy, dy) > segment.maxY) continue;
+                    if (SegmentsIntersect(ax, ay, bx, by, cx, cy, dx, dy)) return true;
+                }
+            }
+        }
+    }
+
+    // No boundary contact left: they intersect only if one lies entirely inside the other
+    int va = a.partStart[a.featurePart[fa]];
+    int vb = b.partStart[b.featurePart[fb]];
+    if (FeatureContainsPoint(b, fb, a.x[va], a.y[va])) return true;
+    if (FeatureContainsPoint(a, fa, b.x[vb], b.y[vb])) return true;
+
+    return false;
+}
+
+// Exact containment: every vertex of feature fa inside polygon feature fb and no boundary
+// crossing between them. Points on the boundary of fb are not contained.
+inline bool FeatureWithin(const Layer &a, int fa, const Layer &b, int fb)
+{
+    if (!IsPolygonType(b.shapeType)) return false;
+    const Bounds &ba = a.featureBounds[fa];
+    const Bounds &bb = b.featureBounds[fb];
+    if (BoundsIsEmpty(ba) || ba.minX < bb.minX || ba.maxX > bb.maxX || ba.minY < bb.minY || ba.maxY > bb.maxY) return false;
+
+    for (int v = a.partStart[a.featurePart[fa]]; v < a.partStart[a.featurePart[fa + 1]]; v++)
+    {
+        if (!FeatureContainsPoint(b, fb, a.x[v], a.y[v])) return false;
+    }
+
+    // A single point inside needs no edge test, longer geometries must not cross a ring
+    if (a.partStart[a.featurePart[fa + 1]] - a.partStart[a.featurePart[fa]] == 1) return true;
+
+    for (int pa = a.featurePart[fa]; pa < a.featurePart[fa + 1]; pa++)
+    {
+        for (int va = a.partStart[pa]; va < a.partStart[pa + 1] - 1; va++)
+        {
+            for (int pb = b.featurePart[fb]; pb < b.featurePart[fb + 1]; pb++)
+            {
+                for (int vb = b.partStart[pb]; vb < b.partStart[pb + 1] - 1; vb++)
+                {
+                    if (SegmentsIntersect(a.x[va], a.y[va], a.x[va + 1], a.y[va + 1],
+                                          b.x[vb], b.y[vb], b.x[vb + 1], b.y[vb + 1])) return false;
+                }
+            }
+        }
+    }
+
+    // A polygon swallowing one of the rings of fb (a hole) is not within it either
+    for (int pb = b.featurePart[fb]; IsPolygonType(a.shapeType) && pb < b.featurePart[fb + 1]; pb++)
+    {
+        int v = b.partStart[pb];
+        if (FeatureContainsPoint(a, fa, b.x[v], b.y[v])) return false;
+    }
+
+    return true;
+}
+
+#endif // VECTORMAP_GEOMETRY_H
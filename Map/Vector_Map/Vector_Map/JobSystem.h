@@ -0,0 +1,191 @@
+#ifndef VECTORMAP_JOB_SYSTEM_H
+#define VECTORMAP_JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//------------------------------------------------------------------------------------
+// JobSystem - work-stealing thread pool
+//
+// Every worker owns a deque. Jobs submitted from a worker go to the back of its own
+// deque and are taken back LIFO, which keeps a job's children hot in cache; idle workers
+// steal the oldest job from the front of someone else's deque. Jobs from other threads
+// (the render thread) are dealt round-robin. A thread waiting on a JobCounter runs jobs
+// itself instead of blocking, so waiting inside a job cannot deadlock the pool.
+//------------------------------------------------------------------------------------
+typedef std::function<void()> Job;
+
+typedef struct JobQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+} JobQueue;
+
+typedef struct JobSystem {
+    std::vector<std::unique_ptr<JobQueue>> queues;     // One per worker
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> pending;                           // Jobs queued and not taken yet
+    std::atomic<unsigned int> nextQueue;                // Round-robin for outside submits
+    bool stop;                                          // Guarded by sleepMutex
+} JobSystem;
+
+// Outstanding jobs of a batch, SubmitJob adds one and the job removes it when done
+typedef std::atomic<int> JobCounter;
+
+// Worker index of the calling thread, -1 outside the pool
+inline int &JobWorkerSlot(void)
+{
+    static thread_local int slot = -1;
+    return slot;
+}
+
+inline int JobSystemThreadCount(const JobSystem &jobs)
+{
+    return (int)jobs.workers.size();
+}
+
+// Take one job, own deque first (newest), then steal from the others (oldest)
+inline bool JobSystemTake(JobSystem *jobs, Job *job)
+{
+    int count = (int)jobs->queues.size();
+    int slot = JobWorkerSlot();
+
+    if (slot >= 0)
+    {
+        JobQueue &own = *jobs->queues[slot];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            *job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            jobs->pending--;
+            return true;
+        }
+    }
+
+    for (int i = 1; i <= count; i++)
+    {
+        JobQueue &victim = *jobs->queues[(slot + i + count)%count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+        *job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        jobs->pending--;
+        return true;
+    }
+
+    return false;
+}
+
+// Run one queued job on the calling thread, returns false when there was none
+inline bool JobSystemRunOne(JobSystem *jobs)
+{
+    Job job;
+    if (!JobSystemTake(jobs, &job)) return false;
+    job();
+    return true;
+}
+
+inline void JobSystemWorker(JobSystem *jobs, int slot)
+{
+    JobWorkerSlot() = slot;
+
+    for (;;)
+    {
+        if (JobSystemRunOne(jobs)) continue;
+
+        std::unique_lock<std::mutex> lock(jobs->sleepMutex);
+        jobs->wake.wait(lock, [jobs]() { return jobs->stop || jobs->pending.load() > 0; });
+        if (jobs->stop) break;
+    }
+}
+
+// threadCount <= 0 uses every hardware thread but one, which is left to the render thread
+inline JobSystem *CreateJobSystem(int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        int hardware = (int)std::thread::hardware_concurrency();
+        threadCount = (hardware > 1) ? hardware - 1 : 1;
+    }
+
+    JobSystem *jobs = new JobSystem();
+    jobs->pending = 0;
+    jobs->nextQueue = 0;
+    jobs->stop = false;
+    for (int i = 0; i < threadCount; i++) jobs->queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+    for (int i = 0; i < threadCount; i++) jobs->workers.push_back(std::thread(JobSystemWorker, jobs, i));
+
+    return jobs;
+}
+
+// Queue a job, 'counter' (optional) is raised now and lowered once the job has run
+inline void SubmitJob(JobSystem *jobs, Job job, JobCounter *counter)
+{
+    if (counter != NULL)
+    {
+        (*counter)++;
+        Job inner = job;
+        job = [inner, counter]() { inner(); (*counter)--; };
+    }
+
+    int slot = JobWorkerSlot();
+    if (slot < 0) slot = (int)(jobs->nextQueue++%jobs->queues.size());
+
+    {
+        JobQueue &queue = *jobs->queues[slot];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+        jobs->pending++;
+    }
+
+    // Taking the sleep lock orders the increment before a worker's predicate check
+    { std::lock_guard<std::mutex> lock(jobs->sleepMutex); }
+    jobs->wake.notify_one();
+}
+
+// Help with queued jobs until the counter drops to 0
+inline void WaitJobCounter(JobSystem *jobs, const JobCounter *counter)
+{
+    while (counter->load() > 0)
+    {
+        if (!JobSystemRunOne(jobs)) std::this_thread::yield();
+    }
+}
+
+// Run body(first, last) over [0, count) in blocks of 'grain' and wait for all of them
+template <typename Body>
+inline void ParallelFor(JobSystem *jobs, int count, int grain, Body body)
+{
+    if (grain < 1) grain = 1;
+    JobCounter counter(0);
+    for (int first = 0; first < count; first += grain)
+    {
+        int last = (first + grain < count) ? first + grain : count;
+        SubmitJob(jobs, [&body, first, last]() { body(first, last); }, &counter);
+    }
+    WaitJobCounter(jobs, &counter);
+}
+
+// Finish the workers, jobs still queued are dropped
+inline void DestroyJobSystem(JobSystem *jobs)
+{
+    if (jobs == NULL) return;
+
+    {
+        std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+        jobs->stop = true;
+    }
+    jobs->wake.notify_all();
+    for (int i = 0; i < (int)jobs->workers.size(); i++) jobs->workers[i].join();
+    delete jobs;
+}
+
+#endif // VECTORMAP_JOB_SYSTEM_H
@@ -0,0 +1,344 @@
+#ifndef VECTORMAP_LABELS_H
+#define VECTORMAP_LABELS_H
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "shapefil.h"
+#include "Layer.h"
+#include "Geometry.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <math.h>
+
+#define LABEL_FONT_SIZE 16.0f       // Pixels
+#define LABEL_SPACING 1.0f          // Pixels between glyphs
+#define LABEL_PADDING 4.0f          // Free pixels kept around every label
+#define LABEL_GRID_CELL 64.0f       // Collision grid cell in pixels
+#define LABEL_ZOOM_STEPS 2          // Placements cached per half octave of zoom
+
+//------------------------------------------------------------------------------------
+// Labels - feature names placed without overlap and drawn in one batch
+//
+// Every feature with a non-empty text gets one anchor: the point itself, the middle of
+// the longest line part by length, or the polygon centroid (moved onto the widest
+// horizontal chord when the centroid falls outside, as for a crescent). Placement is
+// greedy by priority (area or length, larger first) against a hashed grid of already
+// placed boxes. Boxes are fixed in pixels, so one placement holds for one zoom; zoom is
+// bucketed, each bucket placed once at its lowest zoom and cached, so labels never
+// collide at any zoom inside the bucket (camera rotation is not considered). Drawing
+// decodes nothing: glyph indices are resolved at build time and every visible glyph
+// becomes one quad from the font atlas, all under one texture so rlgl batches them.
+//------------------------------------------------------------------------------------
+typedef struct Label {
+    double x;                   // Anchor in drawing space
+    double y;
+    float width;                // Text size in pixels
+    float height;
+    double priority;
+    std::vector<int> glyphs;    // Glyph indices into the font
+} Label;
+
+typedef struct LabelSet {
+    Font font;
+    float fontSize;
+    std::vector<Label> labels;
+    std::vector<int> order;                         // Labels by decreasing priority
+    std::map<int, std::vector<int>> placements;     // Placed labels per zoom bucket
+} LabelSet;
+
+// Read a text field of the .dbf, one string per record. NULL picks the first text field.
+inline bool LoadLabelTexts(const char *fileName, const char *field, std::vector<std::string> *texts)
+{
+    DBFHandle hDBF = DBFOpen(fileName, "rb");
+    if (hDBF == NULL) return false;
+
+    int iField = -1;
+    if (field != NULL) iField = DBFGetFieldIndex(hDBF, field);
+    for (int i = 0; field == NULL && i < DBFGetFieldCount(hDBF); i++)
+    {
+        if (DBFGetFieldInfo(hDBF, i, NULL, NULL, NULL) == FTString)
+        {
+            iField = i;
+            break;
+        }
+    }
+
+    if (iField >= 0)
+    {
+        int records = DBFGetRecordCount(hDBF);
+        texts->resize(records);
+        for (int i = 0; i < records; i++)
+        {
+            if (!DBFIsAttributeNULL(hDBF, i, iField)) (*texts)[i] = DBFReadStringAttribute(hDBF, i, iField);
+        }
+    }
+
+    DBFClose(hDBF);
+    return iField >= 0;
+}
+
+// Anchor and priority of one feature in layer coordinates, false for empty features
+inline bool FeatureLabelAnchor(const Layer &layer, int feature, double *x, double *y, double *priority)
+{
+    int firstPart = layer.featurePart[feature];
+    int lastPart = layer.featurePart[feature + 1];
+    if (firstPart == lastPart) return false;
+
+    if (IsPointType(layer.shapeType))
+    {
+        *x = layer.x[layer.partStart[firstPart]];
+        *y = layer.y[layer.partStart[firstPart]];
+        *priority = 0.0;
+        return true;
+    }
+
+    if (IsLineType(layer.shapeType))
+    {
+        // Middle of the longest part, measured along the line
+        int best = firstPart;
+        double bestLength = -1.0, total = 0.0;
+        for (int p = firstPart; p < lastPart; p++)
+        {
+            double length = 0.0;
+            for (int v = layer.partStart[p]; v < layer.partStart[p + 1] - 1; v++) length += hypot(layer.x[v + 1] - layer.x[v], layer.y[v + 1] - layer.y[v]);
+            if (length > bestLength)
+            {
+                best = p;
+                bestLength = length;
+            }
+            total += length;
+        }
+
+        double half = 0.5*bestLength;
+        *x = layer.x[layer.partStart[best]];
+        *y = layer.y[layer.partStart[best]];
+        for (int v = layer.partStart[best]; v < layer.partStart[best + 1] - 1; v++)
+        {
+            double length = hypot(layer.x[v + 1] - layer.x[v], layer.y[v + 1] - layer.y[v]);
+            if (length >= half && length > 0.0)
+            {
+                *x = layer.x[v] + (layer.x[v + 1] - layer.x[v])*half/length;
+                *y = layer.y[v] + (layer.y[v + 1] - layer.y[v])*half/length;
+                break;
+            }
+            half -= length;
+        }
+        *priority = total;
+        return true;
+    }
+
+    // Area centroid over all rings, holes are wound the other way and subtract themselves
+    double area = 0.0, cx = 0.0, cy = 0.0;
+    double ox = layer.x[layer.partStart[firstPart]], oy = layer.y[layer.partStart[firstPart]];
+    for (int p = firstPart; p < lastPart; p++)
+    {
+        for (int v = layer.partStart[p]; v < layer.partStart[p + 1] - 1; v++)
+        {
+            double ax = layer.x[v] - ox, ay = layer.y[v] - oy, bx = layer.x[v + 1] - ox, by = layer.y[v + 1] - oy;
+            double cross = ax*by - bx*ay;
+            area += cross;
+            cx += (ax + bx)*cross;
+            cy += (ay + by)*cross;
+        }
+    }
+
+    if (area == 0.0)
+    {
+        *x = ox;
+        *y = oy;
+        *priority = 0.0;
+        return true;
+    }
+
+    *x = ox + cx/(3.0*area);
+    *y = oy + cy/(3.0*area);
+    *priority = 0.5*fabs(area);
+    if (FeatureContainsPoint(layer, feature, *x, *y)) return true;
+
+    // Centroid outside: middle of the widest inside stretch of the horizontal line through it
+    std::vector<double> crossings;
+    for (int p = firstPart; p < lastPart; p++)
+    {
+        for (int v = layer.partStart[p]; v < layer.partStart[p + 1] - 1; v++)
+        {
+            double ay = layer.y[v], by = layer.y[v + 1];
+            if ((ay > *y) == (by > *y)) continue;
+            crossings.push_back(layer.x[v] + (*y - ay)*(layer.x[v + 1] - layer.x[v])/(by - ay));
+        }
+    }
+    std::sort(crossings.begin(), crossings.end());
+
+    double widest = -1.0;
+    for (int i = 0; i + 1 < (int)crossings.size(); i += 2)
+    {
+        if (crossings[i + 1] - crossings[i] > widest)
+        {
+            widest = crossings[i + 1] - crossings[i];
+            *x = 0.5*(crossings[i] + crossings[i + 1]);
+        }
+    }
+
+    return true;
+}
+
+// One label per feature with a non-empty text, 'project' maps layer x, y to drawing space
+template <typename Projector>
+inline LabelSet BuildLabelSet(const Layer &layer, const std::vector<std::string> &texts, Projector project, Font font, float fontSize)
+{
+    LabelSet set;
+    set.font = font;
+    set.fontSize = fontSize;
+
+    float scale = fontSize/font.baseSize;
+    for (int f = 0; f < layer.featureCount && f < (int)texts.size(); f++)
+    {
+        if (texts[f].empty()) continue;
+
+        Label label;
+        double x, y;
+        if (!FeatureLabelAnchor(layer, f, &x, &y, &label.priority)) continue;
+        Vector2 anchor = project(x, y);
+        label.x = anchor.x;
+        label.y = anchor.y;
+
+        // Same advance rules as DrawTextEx, so the box matches what is drawn
+        label.width = 0.0f;
+        const char *text = texts[f].c_str();
+        for (int i = 0; text[i] != '\0';)
+        {
+            int size = 0;
+            int index = GetGlyphIndex(font, GetCodepointNext(&text[i], &size));
+            i += size;
+            label.glyphs.push_back(index);
+            float advance = (font.glyphs[index].advanceX == 0) ? font.recs[index].width : (float)font.glyphs[index].advanceX;
+            label.width += advance*scale + LABEL_SPACING;
+        }
+        label.width -= LABEL_SPACING;
+        label.height = fontSize;
+
+        set.labels.push_back(label);
+    }
+
+    set.order.resize(set.labels.size());
+    for (int i = 0; i < (int)set.order.size(); i++) set.order[i] = i;
+    std::stable_sort(set.order.begin(), set.order.end(), [&set](int a, int b) { return set.labels[a].priority > set.labels[b].priority; });
+
+    return set;
+}
+
+inline long long LabelCellKey(int cx, int cy)
+{
+    return ((long long)cx << 32) ^ (long long)(unsigned int)cy;
+}
+
+// Greedy placement at 'zoom': a label is kept when its padded box overlaps no kept box
+inline std::vector<int> PlaceLabels(const LabelSet &set, float zoom)
+{
+    std::vector<int> placed;
+    std::vector<Bounds> boxes;
+    std::unordered_map<long long, std::vector<int>> grid;
+    double cell = LABEL_GRID_CELL/zoom;
+
+    for (int k = 0; k < (int)set.order.size(); k++)
+    {
+        const Label &label = set.labels[set.order[k]];
+        double halfWidth = 0.5*(label.width + 2.0f*LABEL_PADDING)/zoom;
+        double halfHeight = 0.5*(label.height + 2.0f*LABEL_PADDING)/zoom;
+        Bounds box = { label.x - halfWidth, label.y - halfHeight, label.x + halfWidth, label.y + halfHeight };
+
+        int x0 = (int)floor(box.minX/cell), x1 = (int)floor(box.maxX/cell);
+        int y0 = (int)floor(box.minY/cell), y1 = (int)floor(box.maxY/cell);
+
+        bool clear = true;
+        for (int cy = y0; clear && cy <= y1; cy++)
+        {
+            for (int cx = x0; clear && cx <= x1; cx++)
+            {
+                auto it = grid.find(LabelCellKey(cx, cy));
+                if (it == grid.end()) continue;
+                for (int i = 0; clear && i < (int)it->second.size(); i++)
+                {
+                    const Bounds &other = boxes[it->second[i]];
+                    if (box.minX < other.maxX && box.maxX > other.minX && box.minY < other.maxY && box.maxY > other.minY) clear = false;
+                }
+            }
+        }
+        if (!clear) continue;
+
+        for (int cy = y0; cy <= y1; cy++)
+        {
+            for (int cx = x0; cx <= x1; cx++) grid[LabelCellKey(cx, cy)].push_back((int)boxes.size());
+        }
+        boxes.push_back(box);
+        placed.push_back(set.order[k]);
+    }
+
+    return placed;
+}
+
+// Cached placement for the bucket holding 'zoom'
+inline const std::vector<int> &LabelSetPlacement(LabelSet *set, float zoom)
+{
+    int bucket = (int)floorf(log2f(zoom)*LABEL_ZOOM_STEPS);
+    auto it = set->placements.find(bucket);
+    if (it != set->placements.end()) return it->second;
+
+    float bucketZoom = exp2f((float)bucket/LABEL_ZOOM_STEPS);
+    return set->placements[bucket] = PlaceLabels(*set, bucketZoom);
+}
+
+// Draw the placed labels upright in screen space, call outside BeginMode2D
+inline void DrawLabels(LabelSet *set, Camera2D camera, int width, int height, Color color)
+{
+    const std::vector<int> &placed = LabelSetPlacement(set, camera.zoom);
+    const Font &font = set->font;
+    float scale = set->fontSize/font.baseSize;
+    float padding = (float)font.glyphPadding;
+    float texWidth = (float)font.texture.width, texHeight = (float)font.texture.height;
+
+    rlSetTexture(font.texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(color.r, color.g, color.b, color.a);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    for (int k = 0; k < (int)placed.size(); k++)
+    {
+        const Label &label = set->labels[placed[k]];
+        Vector2 anchor = GetWorldToScreen2D(Vector2{ (float)label.x, (float)label.y }, camera);
+        float left = anchor.x - 0.5f*label.width, top = anchor.y - 0.5f*label.height;
+        if (left > width || top > height || left + label.width < 0.0f || top + label.height < 0.0f) continue;
+
+        float penX = floorf(left);
+        for (int i = 0; i < (int)label.glyphs.size(); i++)
+        {
+            int index = label.glyphs[i];
+            const Rectangle &rec = font.recs[index];
+            const GlyphInfo &glyph = font.glyphs[index];
+
+            if (glyph.value != ' ' && glyph.value != '\t')
+            {
+                float x = penX + (glyph.offsetX - padding)*scale;
+                float y = floorf(top) + (glyph.offsetY - padding)*scale;
+                float w = (rec.width + 2.0f*padding)*scale;
+                float h = (rec.height + 2.0f*padding)*scale;
+                float u0 = (rec.x - padding)/texWidth, v0 = (rec.y - padding)/texHeight;
+                float u1 = (rec.x + rec.width + padding)/texWidth, v1 = (rec.y + rec.height + padding)/texHeight;
+
+                rlTexCoord2f(u0, v0); rlVertex2f(x, y);
+                rlTexCoord2f(u0, v1); rlVertex2f(x, y + h);
+                rlTexCoord2f(u1, v1); rlVertex2f(x + w, y + h);
+                rlTexCoord2f(u1, v0); rlVertex2f(x + w, y);
+            }
+
+            penX += ((glyph.advanceX == 0) ? rec.width : (float)glyph.advanceX)*scale + LABEL_SPACING;
+        }
+    }
+
+    rlEnd();
+    rlSetTexture(0);
+}
+
+#endif // VECTORMAP_LABELS_H
@@ -0,0 +1,207 @@
+#ifndef VECTORMAP_LAYER_H
+#define VECTORMAP_LAYER_H
+
+#include "shapefil.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <float.h>
+#include <math.h>
+
+//------------------------------------------------------------------------------------
+// Layer - columnar copy of a shapefile
+//
+// Every feature of the .shp is flattened into shared coordinate arrays so the
+// index, renderer and geometry kernels can walk them without going back to
+// SHPReadObject. Feature f owns parts [featurePart[f], featurePart[f + 1]) and
+// part p owns vertices [partStart[p], partStart[p + 1]). Numeric attributes are held
+// as named columns of featureCount values, NAN marks a NULL.
+//------------------------------------------------------------------------------------
+typedef struct Bounds {
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+} Bounds;
+
+typedef struct Layer {
+    int shapeType;                  // SHPT_* of the source file
+    int featureCount;
+    Bounds bounds;                  // Extent of all features
+    std::vector<Bounds> featureBounds;
+    std::vector<int> featurePart;   // featureCount + 1 offsets into partStart
+    std::vector<int> partStart;     // partCount + 1 offsets into x/y
+    std::vector<double> x;
+    std::vector<double> y;
+    std::map<std::string, std::vector<double>> columns;
+} Layer;
+
+inline Bounds EmptyBounds(void)
+{
+    Bounds b = { DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX };
+    return b;
+}
+
+inline bool BoundsIsEmpty(const Bounds &b)
+{
+    return b.minX > b.maxX || b.minY > b.maxY;
+}
+
+inline void BoundsExtend(Bounds *b, double x, double y)
+{
+    if (x < b->minX) b->minX = x;
+    if (y < b->minY) b->minY = y;
+    if (x > b->maxX) b->maxX = x;
+    if (y > b->maxY) b->maxY = y;
+}
+
+inline void BoundsMerge(Bounds *b, const Bounds &other)
+{
+    if (other.minX < b->minX) b->minX = other.minX;
+    if (other.minY < b->minY) b->minY = other.minY;
+    if (other.maxX > b->maxX) b->maxX = other.maxX;
+    if (other.maxY > b->maxY) b->maxY = other.maxY;
+}
+
+inline bool BoundsIntersect(const Bounds &a, const Bounds &b)
+{
+    return a.minX <= b.maxX && a.maxX >= b.minX && a.minY <= b.maxY && a.maxY >= b.minY;
+}
+
+// Overlap of two boxes, empty when they are disjoint
+inline Bounds BoundsIntersection(const Bounds &a, const Bounds &b)
+{
+    Bounds r = { fmax(a.minX, b.minX), fmax(a.minY, b.minY), fmin(a.maxX, b.maxX), fmin(a.maxY, b.maxY) };
+    return BoundsIsEmpty(r) ? EmptyBounds() : r;
+}
+
+inline bool BoundsContainsPoint(const Bounds &b, double x, double y)
+{
+    return x >= b.minX && x <= b.maxX && y >= b.minY && y <= b.maxY;
+}
+
+inline bool BoundsContainsBounds(const Bounds &outer, const Bounds &inner)
+{
+    return inner.minX >= outer.minX && inner.maxX <= outer.maxX && inner.minY >= outer.minY && inner.maxY <= outer.maxY;
+}
+
+// Squared distance from a point to a box, zero when the point is inside
+inline double BoundsDistanceSq(const Bounds &b, double x, double y)
+{
+    double dx = (x < b.minX) ? b.minX - x : ((x > b.maxX) ? x - b.maxX : 0.0);
+    double dy = (y < b.minY) ? b.minY - y : ((y > b.maxY) ? y - b.maxY : 0.0);
+    return dx*dx + dy*dy;
+}
+
+inline bool IsPolygonType(int shapeType)
+{
+    return shapeType == SHPT_POLYGON || shapeType == SHPT_POLYGONZ || shapeType == SHPT_POLYGONM;
+}
+
+inline bool IsLineType(int shapeType)
+{
+    return shapeType == SHPT_ARC || shapeType == SHPT_ARCZ || shapeType == SHPT_ARCM;
+}
+
+inline bool IsPointType(int shapeType)
+{
+    return shapeType == SHPT_POINT || shapeType == SHPT_POINTZ || shapeType == SHPT_POINTM ||
+           shapeType == SHPT_MULTIPOINT || shapeType == SHPT_MULTIPOINTZ || shapeType == SHPT_MULTIPOINTM;
+}
+
+inline int LayerPartCount(const Layer &layer)
+{
+    return (int)layer.partStart.size() - 1;
+}
+
+// Append one SHPObject (or an empty feature for NULL records) to the layer
+inline void LayerAppendObject(Layer *layer, const SHPObject *obj)
+{
+    if (layer->featurePart.empty()) layer->featurePart.push_back(0);
+    if (layer->partStart.empty()) layer->partStart.push_back(0);
+
+    Bounds b = EmptyBounds();
+
+    if (obj != NULL && obj->nVertices > 0)
+    {
+        // Points and multipoints carry no parts, store every vertex as its own part
+        bool pointParts = (obj->nParts == 0);
+        int partCount = pointParts ? obj->nVertices : obj->nParts;
+
+        for (int p = 0; p < partCount; p++)
+        {
+            int start = pointParts ? p : obj->panPartStart[p];
+            int end = pointParts ? p + 1 : ((p + 1 < obj->nParts) ? obj->panPartStart[p + 1] : obj->nVertices);
+            if (end <= start) continue;
+            for (int v = start; v < end; v++)
+            {
+                layer->x.push_back(obj->padfX[v]);
+                layer->y.push_back(obj->padfY[v]);
+                BoundsExtend(&b, obj->padfX[v], obj->padfY[v]);
+            }
+            layer->partStart.push_back((int)layer->x.size());
+        }
+    }
+
+    layer->featurePart.push_back((int)layer->partStart.size() - 1);
+    layer->featureBounds.push_back(b);
+    if (!BoundsIsEmpty(b)) BoundsMerge(&layer->bounds, b);
+    layer->featureCount++;
+}
+
+// Load every record of a shapefile into a columnar layer, featureCount is 0 on failure
+inline Layer LoadLayer(const char *fileName)
+{
+    Layer layer;
+    layer.shapeType = SHPT_NULL;
+    layer.featureCount = 0;
+    layer.bounds = EmptyBounds();
+    layer.featurePart.push_back(0);
+    layer.partStart.push_back(0);
+
+    SHPHandle hSHP = SHPOpen(fileName, "rb");
+    if (hSHP == NULL) return layer;
+
+    int nEntities = 0, nShapeType = 0;
+    SHPGetInfo(hSHP, &nEntities, &nShapeType, NULL, NULL);
+    layer.shapeType = nShapeType;
+    layer.featureBounds.reserve(nEntities);
+    layer.featurePart.reserve(nEntities + 1);
+
+    for (int i = 0; i < nEntities; i++)
+    {
+        SHPObject *obj = SHPReadObject(hSHP, i);
+        LayerAppendObject(&layer, obj);
+        if (obj != NULL) SHPDestroyObject(obj);
+    }
+
+    SHPClose(hSHP);
+    return layer;
+}
+
+// Read a numeric .dbf field into layer.columns[field], returns false if the field is missing
+inline bool LayerLoadColumn(Layer *layer, const char *fileName, const char *field)
+{
+    DBFHandle hDBF = DBFOpen(fileName, "rb");
+    if (hDBF == NULL) return false;
+
+    int iField = DBFGetFieldIndex(hDBF, field);
+    if (iField < 0)
+    {
+        DBFClose(hDBF);
+        return false;
+    }
+
+    std::vector<double> &column = layer->columns[field];
+    column.assign(layer->featureCount, NAN);
+    int records = DBFGetRecordCount(hDBF);
+    for (int i = 0; i < records && i < layer->featureCount; i++)
+    {
+        if (!DBFIsAttributeNULL(hDBF, i, iField)) column[i] = DBFReadDoubleAttribute(hDBF, i, iField);
+    }
+
+    DBFClose(hDBF);
+    return true;
+}
+
+#endif // VECTORMAP_LAYER_H
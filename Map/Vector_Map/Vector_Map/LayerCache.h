@@ -0,0 +1,126 @@
+#ifndef VECTORMAP_LAYER_CACHE_H
+#define VECTORMAP_LAYER_CACHE_H
+
+#include "Layer.h"
+#include "Projection.h"
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define LAYER_CACHE_MAGIC 0x434C4D56u       // "VMLC"
+#define LAYER_CACHE_VERSION 2               // Bump when Layer, Projection or the stored columns change
+#define LAYER_CACHE_EXTENSION ".cache"      // Appended to the .shp path
+
+//------------------------------------------------------------------------------------
+// LayerCache - binary snapshot of a loaded and reprojected layer
+//
+// Reading a shapefile record by record and reprojecting every vertex is paid once: the
+// columnar arrays are written as they are in memory and read back with one fread per
+// array. The key records what the snapshot was built from (size and modification time
+// of the .shp and .prj plus the requested projection); any difference rebuilds it.
+//------------------------------------------------------------------------------------
+inline std::string LayerCacheKey(const char *shapeFile, const char *variant)
+{
+    std::string prj(shapeFile);
+    size_t dot = prj.find_last_of('.');
+    size_t slash = prj.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) prj.erase(dot);
+    prj += ".prj";
+
+    struct stat shp, proj;
+    long long shpSize = (stat(shapeFile, &shp) == 0) ? (long long)shp.st_size : -1;
+    long long shpTime = (shpSize >= 0) ? (long long)shp.st_mtime : 0;
+    long long prjTime = (stat(prj.c_str(), &proj) == 0) ? (long long)proj.st_mtime : 0;
+
+    char key[128];
+    snprintf(key, sizeof(key), "%lld:%lld:%lld:", shpSize, shpTime, prjTime);
+    return std::string(key) + ((variant != NULL) ? variant : "");
+}
+
+template <typename T>
+inline void LayerCacheWrite(FILE *file, const std::vector<T> &values)
+{
+    unsigned long long count = values.size();
+    fwrite(&count, sizeof(count), 1, file);
+    if (count > 0) fwrite(values.data(), sizeof(T), values.size(), file);
+}
+
+template <typename T>
+inline bool LayerCacheRead(FILE *file, std::vector<T> *values)
+{
+    unsigned long long count = 0;
+    if (fread(&count, sizeof(count), 1, file) != 1 || count > (1ull << 40)/sizeof(T)) return false;
+    values->resize((size_t)count);
+    return count == 0 || fread(values->data(), sizeof(T), (size_t)count, file) == count;
+}
+
+inline bool SaveLayerCache(const char *cacheFile, const std::string &key, const Layer &layer, const Projection &projection)
+{
+    FILE *file = fopen(cacheFile, "wb");
+    if (file == NULL) return false;
+
+    unsigned int header[2] = { LAYER_CACHE_MAGIC, LAYER_CACHE_VERSION };
+    fwrite(header, sizeof(header), 1, file);
+    LayerCacheWrite(file, std::vector<char>(key.begin(), key.end()));
+    fwrite(&projection, sizeof(projection), 1, file);
+    fwrite(&layer.shapeType, sizeof(layer.shapeType), 1, file);
+    fwrite(&layer.featureCount, sizeof(layer.featureCount), 1, file);
+    fwrite(&layer.bounds, sizeof(layer.bounds), 1, file);
+    LayerCacheWrite(file, layer.featureBounds);
+    LayerCacheWrite(file, layer.featurePart);
+    LayerCacheWrite(file, layer.partStart);
+    LayerCacheWrite(file, layer.x);
+    LayerCacheWrite(file, layer.y);
+
+    unsigned long long columns = layer.columns.size();
+    fwrite(&columns, sizeof(columns), 1, file);
+    for (std::map<std::string, std::vector<double>>::const_iterator it = layer.columns.begin(); it != layer.columns.end(); ++it)
+    {
+        LayerCacheWrite(file, std::vector<char>(it->first.begin(), it->first.end()));
+        LayerCacheWrite(file, it->second);
+    }
+
+    bool written = (ferror(file) == 0);
+    fclose(file);
+    if (!written) remove(cacheFile);
+    return written;
+}
+
+// False when the file is missing, from another version or key, or truncated
+inline bool LoadLayerCache(const char *cacheFile, const std::string &key, Layer *layer, Projection *projection)
+{
+    FILE *file = fopen(cacheFile, "rb");
+    if (file == NULL) return false;
+
+    Layer loaded;
+    unsigned int header[2] = { 0, 0 };
+    std::vector<char> storedKey;
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == LAYER_CACHE_MAGIC && header[1] == LAYER_CACHE_VERSION &&
+              LayerCacheRead(file, &storedKey) && std::string(storedKey.begin(), storedKey.end()) == key &&
+              fread(projection, sizeof(*projection), 1, file) == 1 &&
+              fread(&loaded.shapeType, sizeof(loaded.shapeType), 1, file) == 1 &&
+              fread(&loaded.featureCount, sizeof(loaded.featureCount), 1, file) == 1 &&
+              fread(&loaded.bounds, sizeof(loaded.bounds), 1, file) == 1 &&
+              LayerCacheRead(file, &loaded.featureBounds) && LayerCacheRead(file, &loaded.featurePart) &&
+              LayerCacheRead(file, &loaded.partStart) && LayerCacheRead(file, &loaded.x) && LayerCacheRead(file, &loaded.y);
+
+    unsigned long long columns = 0;
+    ok = ok && fread(&columns, sizeof(columns), 1, file) == 1;
+    for (unsigned long long c = 0; ok && c < columns; c++)
+    {
+        std::vector<char> name;
+        ok = LayerCacheRead(file, &name) && LayerCacheRead(file, &loaded.columns[std::string(name.begin(), name.end())]);
+    }
+    fclose(file);
+
+    // The offsets must describe the arrays before anything walks them
+    ok = ok && loaded.featureCount >= 0 && (int)loaded.featureBounds.size() == loaded.featureCount &&
+         (int)loaded.featurePart.size() == loaded.featureCount + 1 && !loaded.partStart.empty() &&
+         loaded.featurePart.back() == (int)loaded.partStart.size() - 1 &&
+         loaded.partStart.back() == (int)loaded.x.size() && loaded.x.size() == loaded.y.size();
+    if (ok) *layer = loaded;
+    return ok;
+}
+
+#endif // VECTORMAP_LAYER_CACHE_H
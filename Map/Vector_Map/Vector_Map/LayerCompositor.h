@@ -0,0 +1,138 @@
+#ifndef VECTORMAP_LAYER_COMPOSITOR_H
+#define VECTORMAP_LAYER_COMPOSITOR_H
+
+#include "raylib.h"
+#include "raymath.h"
+#include "RenderFrame.h"
+#include <vector>
+#include <functional>
+#include <math.h>
+
+#define COMPOSITOR_IDLE_DELAY 0.25f     // Seconds the camera must rest before stale layers re-render
+#define COMPOSITOR_MAX_SHIFT 0.25f      // Reprojected content may move this fraction of the window
+#define COMPOSITOR_MAX_SCALE 2.0f       // ... or be magnified or shrunk this much
+#define COMPOSITOR_MAX_TURN 15.0f       // ... or turn this many degrees before it re-renders
+
+//------------------------------------------------------------------------------------
+// LayerCompositor - static layers cached in render textures
+//
+// Each static layer is rendered once into a window-sized RenderTexture2D together with
+// the camera it was rendered with. While the camera moves the cached texture is
+// reprojected: the old and new camera differ by a similarity transform, so the texture
+// is drawn shifted, scaled and rotated in one quad. A layer re-renders when the camera
+// has rested for COMPOSITOR_IDLE_DELAY, when the reprojection drifts too far (uncovered
+// borders, blurry magnification) or when its content was invalidated. Dynamic overlays
+// are drawn over the composited layers every frame as usual.
+//------------------------------------------------------------------------------------
+typedef struct CompositeLayer {
+    RenderTexture2D target;
+    std::function<void(const Camera2D &)> draw;     // Called in BeginMode2D(RelativeCamera(camera))
+    Camera2D camera;                                // Camera the texture was rendered with
+    bool valid;
+} CompositeLayer;
+
+typedef struct LayerCompositor {
+    int width;
+    int height;
+    std::vector<CompositeLayer> layers;
+    Camera2D lastCamera;
+    float idle;         // Seconds since the camera last changed
+    int renders;        // Layers re-rendered by the last UpdateLayerCompositor
+} LayerCompositor;
+
+inline bool CameraEquals(const Camera2D &a, const Camera2D &b)
+{
+    return a.offset.x == b.offset.x && a.offset.y == b.offset.y && a.target.x == b.target.x &&
+           a.target.y == b.target.y && a.rotation == b.rotation && a.zoom == b.zoom;
+}
+
+inline LayerCompositor LoadLayerCompositor(int width, int height)
+{
+    LayerCompositor compositor;
+    compositor.width = width;
+    compositor.height = height;
+    compositor.lastCamera = Camera2D{ { 0.0f, 0.0f }, { 0.0f, 0.0f }, 0.0f, 1.0f };
+    compositor.idle = 0.0f;
+    compositor.renders = 0;
+    return compositor;
+}
+
+// Returns the layer id, layers are independent and drawn with DrawCompositeLayer. Needs an open window.
+inline int AddCompositeLayer(LayerCompositor *compositor, std::function<void(const Camera2D &)> draw)
+{
+    CompositeLayer layer;
+    layer.target = LoadRenderTexture(compositor->width, compositor->height);
+    layer.draw = draw;
+    layer.camera = compositor->lastCamera;
+    layer.valid = false;
+    compositor->layers.push_back(layer);
+    return (int)compositor->layers.size() - 1;
+}
+
+// The layer content changed (new tiles, restyle), it re-renders on the next update
+inline void InvalidateCompositeLayer(LayerCompositor *compositor, int layer)
+{
+    compositor->layers[layer].valid = false;
+}
+
+// Whether a texture rendered with camera 'from' is still good enough to show for 'to'
+inline bool CompositorCanReproject(const LayerCompositor &compositor, const Camera2D &from, const Camera2D &to)
+{
+    float scale = to.zoom/from.zoom;
+    if (scale > COMPOSITOR_MAX_SCALE || scale < 1.0f/COMPOSITOR_MAX_SCALE) return false;
+    if (fabsf(to.rotation - from.rotation) > COMPOSITOR_MAX_TURN) return false;
+
+    // Where the old window centre lands now
+    Vector2 centre = { 0.5f*compositor.width, 0.5f*compositor.height };
+    Vector2 moved = GetWorldToScreen2D(GetScreenToWorld2D(centre, from), to);
+    float limit = COMPOSITOR_MAX_SHIFT*fminf((float)compositor.width, (float)compositor.height);
+    return Vector2Distance(centre, moved) <= limit;
+}
+
+// Call once per frame before BeginDrawing, re-renders the layers that need it
+inline void UpdateLayerCompositor(LayerCompositor *compositor, const Camera2D &camera, float dt)
+{
+    compositor->idle = CameraEquals(camera, compositor->lastCamera) ? compositor->idle + dt : 0.0f;
+    compositor->lastCamera = camera;
+    compositor->renders = 0;
+
+    for (int i = 0; i < (int)compositor->layers.size(); i++)
+    {
+        CompositeLayer &layer = compositor->layers[i];
+        if (layer.valid && CameraEquals(layer.camera, camera)) continue;
+        if (layer.valid && compositor->idle < COMPOSITOR_IDLE_DELAY && CompositorCanReproject(*compositor, layer.camera, camera)) continue;
+
+        BeginTextureMode(layer.target);
+        ClearBackground(BLANK);
+        BeginMode2D(RelativeCamera(camera));
+        layer.draw(camera);
+        EndMode2D();
+        EndTextureMode();
+
+        layer.camera = camera;
+        layer.valid = true;
+        compositor->renders++;
+    }
+}
+
+// Draw a cached layer for 'camera', reprojecting it when it was rendered with another one
+inline void DrawCompositeLayer(const LayerCompositor &compositor, int id, const Camera2D &camera)
+{
+    const CompositeLayer &layer = compositor.layers[id];
+    if (!layer.valid) return;
+
+    // The old window's top-left corner lands at 'corner', its axes are turned and scaled
+    Vector2 corner = GetWorldToScreen2D(GetScreenToWorld2D(Vector2{ 0.0f, 0.0f }, layer.camera), camera);
+    float scale = camera.zoom/layer.camera.zoom;
+    Rectangle source = { 0.0f, 0.0f, (float)layer.target.texture.width, -(float)layer.target.texture.height };
+    Rectangle dest = { corner.x, corner.y, compositor.width*scale, compositor.height*scale };
+    DrawTexturePro(layer.target.texture, source, dest, Vector2{ 0.0f, 0.0f }, camera.rotation - layer.camera.rotation, WHITE);
+}
+
+inline void UnloadLayerCompositor(LayerCompositor *compositor)
+{
+    for (int i = 0; i < (int)compositor->layers.size(); i++) UnloadRenderTexture(compositor->layers[i].target);
+    compositor->layers.clear();
+}
+
+#endif // VECTORMAP_LAYER_COMPOSITOR_H
@@ -0,0 +1,152 @@
+#ifndef VECTORMAP_LAYER_MESH_H
+#define VECTORMAP_LAYER_MESH_H
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "raymath.h"
+#include "Layer.h"
+#include "Triangulator.h"
+#include "RenderFrame.h"
+#include <vector>
+#include <string.h>
+
+#define LAYER_MESH_MAX_VERTICES 65535   // raylib meshes index with unsigned short
+
+//------------------------------------------------------------------------------------
+// LayerMesh - static GPU geometry for one layer and style
+//
+// The cached fill triangulation is uploaded once through UploadMesh, split into chunks
+// that fit 16-bit indices. Positions are floats relative to 'origin' and the mapping to
+// the drawing space travels as the model matrix (see RenderFrame), so drawing costs one
+// call per chunk and nothing per vertex on the CPU.
+//------------------------------------------------------------------------------------
+typedef struct LayerMesh {
+    std::vector<Mesh> chunks;
+    Material material;
+    double originX;
+    double originY;
+} LayerMesh;
+
+// CPU side of one chunk: xyz floats, optional per-vertex normals and 16-bit triangle
+// indices. Building these needs no GL context, so it can run on any thread; only the
+// upload is bound to the window.
+typedef struct MeshChunkData {
+    std::vector<float> vertices;
+    std::vector<float> normals;     // Empty or 3 floats per vertex
+    std::vector<unsigned short> indices;
+} MeshChunkData;
+
+inline size_t MeshChunkBytes(const MeshChunkData &chunk)
+{
+    return (chunk.vertices.size() + chunk.normals.size())*sizeof(float) + chunk.indices.size()*sizeof(unsigned short);
+}
+
+// Pack the fill triangles of every feature into chunks, positions relative to the origin
+inline void BuildFillChunks(const Layer &layer, const LayerFill &fill, double originX, double originY, std::vector<MeshChunkData> *chunks)
+{
+    std::vector<int> remap(layer.x.size(), -1);    // Layer vertex -> chunk vertex
+    std::vector<int> used;                          // Layer vertices mapped in this chunk
+    MeshChunkData chunk;
+
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        int first = fill.featureStart[f];
+        int count = fill.featureStart[f + 1] - first;
+        if (count == 0) continue;
+
+        // Features never straddle chunks, start a new one when this one could overflow
+        if ((int)(chunk.vertices.size()/3) + count > LAYER_MESH_MAX_VERTICES)
+        {
+            chunks->push_back(chunk);
+            chunk.vertices.clear();
+            chunk.indices.clear();
+            for (int i = 0; i < (int)used.size(); i++) remap[used[i]] = -1;
+            used.clear();
+        }
+
+        for (int t = first; t < first + count; t++)
+        {
+            unsigned int v = fill.indices[t];
+            if (remap[v] < 0)
+            {
+                remap[v] = (int)(chunk.vertices.size()/3);
+                used.push_back((int)v);
+                chunk.vertices.push_back((float)(layer.x[v] - originX));
+                chunk.vertices.push_back((float)(layer.y[v] - originY));
+                chunk.vertices.push_back(0.0f);
+            }
+            chunk.indices.push_back((unsigned short)remap[v]);
+        }
+    }
+
+    if (!chunk.indices.empty()) chunks->push_back(chunk);
+}
+
+// Upload one chunk, the GPU keeps its own copy so nothing stays on the CPU side
+inline Mesh UploadMeshChunk(const MeshChunkData &chunk)
+{
+    Mesh mesh = { 0 };
+    mesh.vertexCount = (int)(chunk.vertices.size()/3);
+    mesh.triangleCount = (int)(chunk.indices.size()/3);
+    mesh.vertices = (float *)MemAlloc((unsigned int)(chunk.vertices.size()*sizeof(float)));
+    mesh.indices = (unsigned short *)MemAlloc((unsigned int)(chunk.indices.size()*sizeof(unsigned short)));
+    memcpy(mesh.vertices, chunk.vertices.data(), chunk.vertices.size()*sizeof(float));
+    memcpy(mesh.indices, chunk.indices.data(), chunk.indices.size()*sizeof(unsigned short));
+    if (!chunk.normals.empty())
+    {
+        mesh.normals = (float *)MemAlloc((unsigned int)(chunk.normals.size()*sizeof(float)));
+        memcpy(mesh.normals, chunk.normals.data(), chunk.normals.size()*sizeof(float));
+    }
+
+    UploadMesh(&mesh, false);
+
+    MemFree(mesh.vertices);
+    MemFree(mesh.indices);
+    if (mesh.normals != NULL) MemFree(mesh.normals);
+    mesh.vertices = NULL;
+    mesh.indices = NULL;
+    mesh.normals = NULL;
+    return mesh;
+}
+
+// Upload the fill triangles of every feature, needs an open window (GL context)
+inline LayerMesh LoadLayerFillMesh(const Layer &layer, const LayerFill &fill)
+{
+    LayerMesh layerMesh;
+    layerMesh.material = LoadMaterialDefault();
+    layerMesh.originX = BoundsIsEmpty(layer.bounds) ? 0.0 : layer.bounds.minX;
+    layerMesh.originY = BoundsIsEmpty(layer.bounds) ? 0.0 : layer.bounds.minY;
+
+    std::vector<MeshChunkData> chunks;
+    BuildFillChunks(layer, fill, layerMesh.originX, layerMesh.originY, &chunks);
+    for (int i = 0; i < (int)chunks.size(); i++) layerMesh.chunks.push_back(UploadMeshChunk(chunks[i]));
+
+    return layerMesh;
+}
+
+// Draw uploaded chunks stored relative to (originX, originY), the offset from the frame
+// origin is taken in double so vertices stay small
+inline void DrawMeshChunks(const std::vector<Mesh> &chunks, Material material, double originX, double originY, const RenderFrame &frame, Color color)
+{
+    material.maps[MATERIAL_MAP_DIFFUSE].color = color;
+    Matrix model = RenderFrameMatrix(frame, originX, originY);
+
+    // The world to screen mapping may mirror y, draw both windings
+    rlDisableBackfaceCulling();
+    for (int i = 0; i < (int)chunks.size(); i++) DrawMesh(chunks[i], material, model);
+    rlEnableBackfaceCulling();
+}
+
+inline void DrawLayerMesh(const LayerMesh &layerMesh, const RenderFrame &frame, Color color)
+{
+    DrawMeshChunks(layerMesh.chunks, layerMesh.material, layerMesh.originX, layerMesh.originY, frame, color);
+}
+
+inline void UnloadLayerMesh(LayerMesh *layerMesh)
+{
+    for (int i = 0; i < (int)layerMesh->chunks.size(); i++) UnloadMesh(layerMesh->chunks[i]);
+    layerMesh->chunks.clear();
+    UnloadMaterial(layerMesh->material);
+}
+
+#endif // VECTORMAP_LAYER_MESH_H
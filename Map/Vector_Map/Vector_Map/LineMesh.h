@@ -0,0 +1,322 @@
+#ifndef VECTORMAP_LINE_MESH_H
+#define VECTORMAP_LINE_MESH_H
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "raymath.h"
+#include "Layer.h"
+#include "LayerMesh.h"
+#include "RenderFrame.h"
+#include <vector>
+#include <math.h>
+
+#define LINE_MITER_LIMIT 4.0f           // Longest miter, in half widths, before the join falls back
+#define LINE_ROUND_STEP (PI/8.0f)       // Largest angle covered by one triangle of a round join or cap
+#define LINE_UNIT_MAX_VERTICES 32       // Vertices one segment with its join and cap can emit
+
+//------------------------------------------------------------------------------------
+// LineMesh - thick polylines widened on the GPU
+//
+// Every segment is a quad whose four vertices sit on the centreline and carry their
+// extrusion in the normal attribute: (nx, ny) is the unit offset direction and z scales
+// it, 1 for a plain edge, 1/cos(half turn) on a miter. The vertex shader moves each
+// vertex by normal.xy*normal.z*halfWidth, so the width is a uniform and changes with zoom
+// without rebuilding. Joins beyond the miter limit and all round joins get their own
+// triangle fan around a centre vertex with a zero normal; round joins also cap open ends.
+// Positions are layer units relative to a double origin per chunk, placed relative to the
+// RenderFrame at draw time, so deep zoom into projected coordinates does not jitter.
+// Chunks are built without a GL context (LineMeshData), so tile jobs can build them.
+//------------------------------------------------------------------------------------
+typedef enum {
+    LINE_JOIN_MITER = 0,    // Sharp corners, bevelled past LINE_MITER_LIMIT
+    LINE_JOIN_ROUND,        // Round corners and round caps
+    LINE_JOIN_BEVEL         // Corners cut flat
+} LineJoin;
+
+typedef struct LineMeshData {
+    std::vector<MeshChunkData> chunks;
+    std::vector<Bounds> chunkBounds;    // Source extent of each chunk, for culling
+    std::vector<double> chunkOriginX;   // Source point the chunk's positions are relative to
+    std::vector<double> chunkOriginY;
+} LineMeshData;
+
+typedef struct LineMesh {
+    std::vector<Mesh> chunks;
+    std::vector<Bounds> chunkBounds;
+    std::vector<double> chunkOriginX;
+    std::vector<double> chunkOriginY;
+} LineMesh;
+
+// One per program, shared by every line mesh
+typedef struct LineShader {
+    Material material;                  // Owns the widening shader
+    int halfWidthLoc;
+} LineShader;
+
+static const char *LINE_MESH_VS =
+    "#version 330\n"
+    "in vec3 vertexPosition;\n"
+    "in vec3 vertexNormal;\n"
+    "uniform mat4 mvp;\n"
+    "uniform float halfWidth;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 position = vertexPosition.xy + vertexNormal.xy*vertexNormal.z*halfWidth;\n"
+    "    gl_Position = mvp*vec4(position, vertexPosition.z, 1.0);\n"
+    "}\n";
+
+static const char *LINE_MESH_FS =
+    "#version 330\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main()\n"
+    "{\n"
+    "    finalColor = colDiffuse;\n"
+    "}\n";
+
+inline void LineMeshVertex(MeshChunkData *chunk, float x, float y, float nx, float ny, float scale)
+{
+    chunk->vertices.push_back(x);
+    chunk->vertices.push_back(y);
+    chunk->vertices.push_back(0.0f);
+    chunk->normals.push_back(nx);
+    chunk->normals.push_back(ny);
+    chunk->normals.push_back(scale);
+}
+
+// Fan of triangles around (x, y) sweeping 'angle' radians counter-clockwise from (nx, ny),
+// or clockwise for a negative angle
+inline void LineMeshFan(MeshChunkData *chunk, float x, float y, float nx, float ny, float angle)
+{
+    int steps = (int)ceilf(fabsf(angle)/LINE_ROUND_STEP);
+    if (steps < 1) steps = 1;
+
+    unsigned short centre = (unsigned short)(chunk->vertices.size()/3);
+    LineMeshVertex(chunk, x, y, 0.0f, 0.0f, 0.0f);
+    for (int i = 0; i <= steps; i++)
+    {
+        Vector2 n = Vector2Rotate(Vector2{ nx, ny }, angle*i/steps);
+        LineMeshVertex(chunk, x, y, n.x, n.y, 1.0f);
+        if (i == 0) continue;
+        chunk->indices.push_back(centre);
+        chunk->indices.push_back((unsigned short)(centre + i));
+        chunk->indices.push_back((unsigned short)(centre + i + 1));
+    }
+}
+
+inline void LineMeshQuad(MeshChunkData *chunk, Vector2 a, Vector2 b, Vector2 na, float sa, Vector2 nb, float sb)
+{
+    unsigned short first = (unsigned short)(chunk->vertices.size()/3);
+    LineMeshVertex(chunk, a.x, a.y, na.x, na.y, sa);
+    LineMeshVertex(chunk, a.x, a.y, -na.x, -na.y, sa);
+    LineMeshVertex(chunk, b.x, b.y, nb.x, nb.y, sb);
+    LineMeshVertex(chunk, b.x, b.y, -nb.x, -nb.y, sb);
+
+    unsigned short quad[6] = { 0, 1, 2, 2, 1, 3 };
+    for (int i = 0; i < 6; i++) chunk->indices.push_back((unsigned short)(first + quad[i]));
+}
+
+// Pack the parts of a line or polygon layer into chunks. The layer units must be isotropic
+// (projected), a chunk's positions are relative to the first vertex of its first part.
+inline void BuildLineChunks(const Layer &layer, LineJoin join, LineMeshData *data)
+{
+    MeshChunkData chunk;
+    Bounds bounds = EmptyBounds();
+    double originX = 0.0, originY = 0.0;
+    std::vector<Vector2> points;
+    std::vector<int> sources;
+
+    for (int p = 0; p < LayerPartCount(layer); p++)
+    {
+        if (layer.partStart[p] == layer.partStart[p + 1]) continue;
+        if (chunk.indices.empty())
+        {
+            originX = layer.x[layer.partStart[p]];
+            originY = layer.y[layer.partStart[p]];
+        }
+
+        // Offset in double and drop repeated points, a repeated first vertex marks a closed ring
+        points.clear();
+        sources.clear();
+        for (int v = layer.partStart[p]; v < layer.partStart[p + 1]; v++)
+        {
+            Vector2 q = { (float)(layer.x[v] - originX), (float)(layer.y[v] - originY) };
+            if (!points.empty() && q.x == points.back().x && q.y == points.back().y) continue;
+            points.push_back(q);
+            sources.push_back(v);
+        }
+        bool closed = points.size() > 3 && points.front().x == points.back().x && points.front().y == points.back().y;
+        if (closed)
+        {
+            points.pop_back();
+            sources.pop_back();
+        }
+        int n = (int)points.size();
+        if (n < 2) continue;
+
+        int segments = closed ? n : n - 1;
+        for (int s = 0; s < segments; s++)
+        {
+            if ((int)(chunk.vertices.size()/3) + LINE_UNIT_MAX_VERTICES > LAYER_MESH_MAX_VERTICES)
+            {
+                data->chunks.push_back(chunk);
+                data->chunkBounds.push_back(bounds);
+                data->chunkOriginX.push_back(originX);
+                data->chunkOriginY.push_back(originY);
+                chunk = MeshChunkData();
+                bounds = EmptyBounds();
+            }
+
+            // Segment s runs from vertex s to vertex e, with neighbours r before and t after
+            int e = (s + 1)%n;
+            int r = (s - 1 + n)%n;
+            int t = (e + 1)%n;
+            bool hasPrev = closed || s > 0;
+            bool hasNext = closed || e < n - 1;
+
+            Vector2 d = Vector2Normalize(Vector2Subtract(points[e], points[s]));
+            Vector2 normal = { -d.y, d.x };
+            Vector2 startN = normal, endN = normal;
+            float startScale = 1.0f, endScale = 1.0f;
+
+            // A miter is shared by both segments of the join, so they meet without a gap
+            if (join == LINE_JOIN_MITER && hasPrev)
+            {
+                Vector2 dp = Vector2Normalize(Vector2Subtract(points[s], points[r]));
+                Vector2 miter = Vector2Normalize(Vector2Add(normal, Vector2{ -dp.y, dp.x }));
+                float cosine = Vector2DotProduct(miter, normal);
+                if (cosine > 1.0f/LINE_MITER_LIMIT)
+                {
+                    startN = miter;
+                    startScale = 1.0f/cosine;
+                }
+            }
+
+            Vector2 dn = { 0.0f, 0.0f };
+            bool fan = false;
+            if (hasNext)
+            {
+                dn = Vector2Normalize(Vector2Subtract(points[t], points[e]));
+                Vector2 miter = Vector2Normalize(Vector2Add(normal, Vector2{ -dn.y, dn.x }));
+                float cosine = Vector2DotProduct(miter, normal);
+                if (join == LINE_JOIN_MITER && cosine > 1.0f/LINE_MITER_LIMIT)
+                {
+                    endN = miter;
+                    endScale = 1.0f/cosine;
+                }
+                else fan = true;
+            }
+
+            LineMeshQuad(&chunk, points[s], points[e], startN, startScale, endN, endScale);
+            BoundsExtend(&bounds, layer.x[sources[s]], layer.y[sources[s]]);
+            BoundsExtend(&bounds, layer.x[sources[e]], layer.y[sources[e]]);
+
+            // Unmitered join at e: fill the wedge on the outer side of the turn
+            if (fan)
+            {
+                float cross = d.x*dn.y - d.y*dn.x;
+                float side = (cross > 0.0f) ? -1.0f : 1.0f;
+                float turn = acosf(Clamp(Vector2DotProduct(d, dn), -1.0f, 1.0f));
+                Vector2 from = Vector2Scale(normal, side);
+                float angle = (cross > 0.0f) ? turn : -turn;
+                if (join == LINE_JOIN_ROUND) LineMeshFan(&chunk, points[e].x, points[e].y, from.x, from.y, angle);
+                else
+                {
+                    unsigned short centre = (unsigned short)(chunk.vertices.size()/3);
+                    Vector2 to = Vector2Rotate(from, angle);
+                    LineMeshVertex(&chunk, points[e].x, points[e].y, 0.0f, 0.0f, 0.0f);
+                    LineMeshVertex(&chunk, points[e].x, points[e].y, from.x, from.y, 1.0f);
+                    LineMeshVertex(&chunk, points[e].x, points[e].y, to.x, to.y, 1.0f);
+                    chunk.indices.push_back(centre);
+                    chunk.indices.push_back((unsigned short)(centre + 1));
+                    chunk.indices.push_back((unsigned short)(centre + 2));
+                }
+            }
+
+            // Round caps on the open ends
+            if (join == LINE_JOIN_ROUND && !closed)
+            {
+                if (s == 0) LineMeshFan(&chunk, points[s].x, points[s].y, normal.x, normal.y, PI);
+                if (e == n - 1) LineMeshFan(&chunk, points[e].x, points[e].y, -normal.x, -normal.y, PI);
+            }
+        }
+    }
+
+    if (!chunk.indices.empty())
+    {
+        data->chunks.push_back(chunk);
+        data->chunkBounds.push_back(bounds);
+        data->chunkOriginX.push_back(originX);
+        data->chunkOriginY.push_back(originY);
+    }
+}
+
+inline size_t LineMeshDataBytes(const LineMeshData &data)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < (int)data.chunks.size(); i++) bytes += MeshChunkBytes(data.chunks[i]);
+    return bytes;
+}
+
+// Upload built chunks, needs an open window (GL context)
+inline LineMesh UploadLineMesh(const LineMeshData &data)
+{
+    LineMesh lineMesh;
+    for (int i = 0; i < (int)data.chunks.size(); i++) lineMesh.chunks.push_back(UploadMeshChunk(data.chunks[i]));
+    lineMesh.chunkBounds = data.chunkBounds;
+    lineMesh.chunkOriginX = data.chunkOriginX;
+    lineMesh.chunkOriginY = data.chunkOriginY;
+    return lineMesh;
+}
+
+// Build and upload the line mesh of a layer, needs an open window (GL context)
+inline LineMesh LoadLineMesh(const Layer &layer, LineJoin join)
+{
+    LineMeshData data;
+    BuildLineChunks(layer, join, &data);
+    return UploadLineMesh(data);
+}
+
+// Needs an open window
+inline LineShader LoadLineShader(void)
+{
+    LineShader lineShader;
+    lineShader.material = LoadMaterialDefault();
+    lineShader.material.shader = LoadShaderFromMemory(LINE_MESH_VS, LINE_MESH_FS);
+    lineShader.halfWidthLoc = GetShaderLocation(lineShader.material.shader, "halfWidth");
+    return lineShader;
+}
+
+// Draw the chunks meeting 'view' (source coordinates), halfWidth is in source units: under a
+// Camera2D a constant on-screen width is pixels/(2*zoom*|frame scale|)
+inline void DrawLineMesh(const LineMesh &lineMesh, const LineShader &lineShader, const RenderFrame &frame, const Bounds &view, float halfWidth, Color color)
+{
+    Material material = lineShader.material;
+    material.maps[MATERIAL_MAP_DIFFUSE].color = color;
+    SetShaderValue(material.shader, lineShader.halfWidthLoc, &halfWidth, SHADER_UNIFORM_FLOAT);
+
+    // Quads and fans are wound either way
+    rlDisableBackfaceCulling();
+    for (int i = 0; i < (int)lineMesh.chunks.size(); i++)
+    {
+        if (!BoundsIntersect(lineMesh.chunkBounds[i], view)) continue;
+        DrawMesh(lineMesh.chunks[i], material, RenderFrameMatrix(frame, lineMesh.chunkOriginX[i], lineMesh.chunkOriginY[i]));
+    }
+    rlEnableBackfaceCulling();
+}
+
+inline void UnloadLineMesh(LineMesh *lineMesh)
+{
+    for (int i = 0; i < (int)lineMesh->chunks.size(); i++) UnloadMesh(lineMesh->chunks[i]);
+    lineMesh->chunks.clear();
+    lineMesh->chunkBounds.clear();
+    lineMesh->chunkOriginX.clear();
+    lineMesh->chunkOriginY.clear();
+}
+
+inline void UnloadLineShader(LineShader lineShader)
+{
+    UnloadMaterial(lineShader.material);    // Also unloads the shader
+}
+
+#endif // VECTORMAP_LINE_MESH_H
@@ -1,51 +1,476 @@
 ﻿#include "raylib.h"
-#include "C:\\\\Users\\\\DMAP\\\\Desktop\\\\Ege\\\\VectorMap\\\\Dependencies\\\\shpEge\\\\shapefil.h"
+#include "raymath.h"
+#include "shapefil.h"
+#include "Layer.h"
+#include "SpatialIndex.h"
+#include "PointGrid.h"
+#include "SpatialSort.h"
+#include "SpatialJoin.h"
+#include "PointInPolygon.h"
+#include "Triangulator.h"
+#include "LayerMesh.h"
+#include "TileCache.h"
+#include "Simplify.h"
+#include "Topology.h"
+#include "LineMesh.h"
+#include "LayerCompositor.h"
+#include "JobSystem.h"
+#include "Labels.h"
+#include "Projection.h"
+#include "Prj.h"
+#include "LayerCache.h"
+#include "RenderFrame.h"
+#include "Validate.h"
+#include "Clipper.h"
+#include "Measures.h"
+#include "SelfTest.h"
 #include <string>
 #include <iostream>
 #include <vector>
 #include <stdlib.h>
-#define DEG2LAT 72.83811
-#define DEG2LON 54.13864
-#define LONOFSET 1294.23832784
-#define LATOFSET 3292.13689578
+#include <string.h>
 using namespace std;
 
-typedef struct Polygon {
-    Vector2 *verticies;
-    int verticeCount;
-    int shape;
-}Polygon;
+#define DEFAULT_LAYER "../../../Data/map.shp"
+#define PICK_RADIUS 6.0f        // Pick tolerance in pixels for nearest feature lookup
+#define HUD_RADIUS 50.0f        // Half size in pixels of the feature count box around the cursor
+#define LOD_LEVELS 5            // Source geometry plus four simplified levels
+#define LOD_PIXEL_TOLERANCE 0.5 // Simplification error allowed on screen, in pixels
+#define LOD_MAX_ZOOM 64.0       // Zoom at which the finest simplified level reaches LOD_PIXEL_TOLERANCE
+#define LOD_STREAMED_LEVELS 2   // Finest LOD levels drawn from streamed outline tiles, not kept resident
+#define LINE_WIDTH 1.5f         // Outline width in pixels at any zoom
+#define CAMERA_PAN_SPEED 600.0f // Keyboard pan in pixels per second
+#define CAMERA_ZOOM_STEP 0.1f   // Relative zoom per wheel notch
+#define CAMERA_ROTATE_SPEED 45.0f   // Keyboard rotation in degrees per second
+
+// The layer is projected once at load time, MapView places the projected map units in
+// the screen space of zoom 1 with the layer extent fitted to the window
+typedef struct MapView {
+    Projection projection;
+    double scale;       // Pixels per map unit at zoom 1, the same on both axes
+    double originX;     // Map point at the top-left corner of the window
+    double originY;
+} MapView;
+
+MapView FitMapView(Projection projection, Bounds extent, int width, int height)
+{
+    MapView map;
+    map.projection = projection;
+    map.scale = 1.0;
+    map.originX = 0.0;
+    map.originY = 0.0;
+    if (BoundsIsEmpty(extent)) return map;
+
+    double w = extent.maxX - extent.minX, h = extent.maxY - extent.minY;
+    if (w > 0.0 || h > 0.0) map.scale = fmin((w > 0.0) ? width/w : DBL_MAX, (h > 0.0) ? height/h : DBL_MAX);
+    map.originX = 0.5*(extent.minX + extent.maxX) - 0.5*width/map.scale;
+    map.originY = 0.5*(extent.minY + extent.maxY) + 0.5*height/map.scale;
+    return map;
+}
+
+Vector2 MapToScreen(const MapView &map, double x, double y)
+{
+    return Vector2{ (float)((x - map.originX)*map.scale), (float)((map.originY - y)*map.scale) };
+}
+
+// Same mapping as MapToScreen relative to the camera target, for drawing through
+// RelativeCamera(camera): the target is turned into map units and subtracted in double
+RenderFrame MapRenderFrame(const MapView &map, Camera2D camera)
+{
+    RenderFrame frame;
+    frame.originX = map.originX + camera.target.x/map.scale;
+    frame.originY = map.originY - camera.target.y/map.scale;
+    frame.scaleX = map.scale;
+    frame.scaleY = -map.scale;
+    return frame;
+}
+
+void ScreenToMap(const MapView &map, Vector2 position, double *x, double *y)
+{
+    *x = map.originX + position.x/map.scale;
+    *y = map.originY - position.y/map.scale;
+}
+
+// Map box seen through the camera, every window corner is mapped so rotation is covered
+Bounds CameraViewBounds(const MapView &map, Camera2D camera, int width, int height)
+{
+    Vector2 corners[4] = { { 0.0f, 0.0f }, { (float)width, 0.0f }, { 0.0f, (float)height }, { (float)width, (float)height } };
+    Bounds view = EmptyBounds();
+    for (int i = 0; i < 4; i++)
+    {
+        double x, y;
+        ScreenToMap(map, GetScreenToWorld2D(corners[i], camera), &x, &y);
+        BoundsExtend(&view, x, y);
+    }
+    return view;
+}
+
+// Drag with the left button or arrows/WASD to pan, wheel or +/- to zoom about the cursor,
+// Q/E to rotate and R to reset the view
+void UpdateMapCamera(Camera2D *camera)
+{
+    float dt = GetFrameTime();
+
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+    {
+        Vector2 delta = Vector2Scale(GetMouseDelta(), -1.0f/camera->zoom);
+        camera->target = Vector2Add(camera->target, Vector2Rotate(delta, -camera->rotation*DEG2RAD));
+    }
+
+    Vector2 pan = { 0.0f, 0.0f };
+    if (IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A)) pan.x -= 1.0f;
+    if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D)) pan.x += 1.0f;
+    if (IsKeyDown(KEY_UP) || IsKeyDown(KEY_W)) pan.y -= 1.0f;
+    if (IsKeyDown(KEY_DOWN) || IsKeyDown(KEY_S)) pan.y += 1.0f;
+    pan = Vector2Scale(pan, CAMERA_PAN_SPEED*dt/camera->zoom);
+    camera->target = Vector2Add(camera->target, Vector2Rotate(pan, -camera->rotation*DEG2RAD));
+
+    if (IsKeyDown(KEY_Q)) camera->rotation -= CAMERA_ROTATE_SPEED*dt;
+    if (IsKeyDown(KEY_E)) camera->rotation += CAMERA_ROTATE_SPEED*dt;
+
+    float wheel = GetMouseWheelMove();
+    if (IsKeyDown(KEY_EQUAL) || IsKeyDown(KEY_KP_ADD)) wheel += 5.0f*dt;
+    if (IsKeyDown(KEY_MINUS) || IsKeyDown(KEY_KP_SUBTRACT)) wheel -= 5.0f*dt;
+    if (wheel != 0.0f)
+    {
+        // Keep the world point under the cursor fixed while zooming
+        Vector2 mouse = GetMousePosition();
+        camera->target = GetScreenToWorld2D(mouse, *camera);
+        camera->offset = mouse;
+        camera->zoom *= powf(1.0f + CAMERA_ZOOM_STEP, wheel);
+        if (camera->zoom < 0.25f) camera->zoom = 0.25f;
+        if (camera->zoom > 4096.0f) camera->zoom = 4096.0f;
+    }
+
+    if (IsKeyPressed(KEY_R))
+    {
+        camera->target = Vector2{ 0.0f, 0.0f };
+        camera->offset = Vector2{ 0.0f, 0.0f };
+        camera->rotation = 0.0f;
+        camera->zoom = 1.0f;
+    }
+}
 
 //------------------------------------------------------------------------------------
 // Program main entry point
 //------------------------------------------------------------------------------------
-int main(void)
+int main(int argc, char **argv)
 {
     
 	int nEntities = 0, nShapeType = 0;
 
+    // Tool mode: Vector_Map --sort <source.shp> <target.shp> rewrites a layer in Hilbert order
+    if (argc == 4 && strcmp(argv[1], "--sort") == 0)
+    {
+        bool sorted = SpatialSortShapefile(argv[2], argv[3]);
+        cout << (sorted ? "Sorted " : "Failed to sort ") << argv[2] << " -> " << argv[3] << endl;
+        return sorted ? 0 : 1;
+    }
+
+    // Tool mode: Vector_Map --join <left.shp> <right.shp> prints "left,right" id pairs,
+    // points are joined to the polygons they fall in, everything else on intersection
+    if (argc == 4 && strcmp(argv[1], "--join") == 0)
+    {
+        Layer left = LoadLayer(argv[2]);
+        Layer right = LoadLayer(argv[3]);
+
+        // Single points against polygons go through the batched point-in-polygon kernel
+        vector<double> px, py;
+        if (IsPolygonType(right.shapeType) && LayerPointCoordinates(left, &px, &py))
+        {
+            JobSystem *pipJobs = CreateJobSystem(0);
+            PipIndex pipIndex = BuildPipIndex(right, pipJobs);
+            vector<JoinPair> pairs = PointsInPolygonsPairs(pipIndex, px.data(), py.data(), (int)px.size(), pipJobs);
+            DestroyJobSystem(pipJobs);
+            for (int i = 0; i < (int)pairs.size(); i++) printf("%i,%i\n", pairs[i].left, pairs[i].right);
+            return 0;
+        }
+
+        SpatialIndex rightIndex = BuildLayerIndex(right);
+        JoinPredicate predicate = (IsPointType(left.shapeType) && IsPolygonType(right.shapeType)) ? JOIN_WITHIN : JOIN_INTERSECTS;
+        SpatialJoin(left, right, rightIndex, predicate, 0, [](const JoinPair *pairs, int count) {
+            for (int i = 0; i < count; i++) printf("%i,%i\n", pairs[i].left, pairs[i].right);
+        });
+        return 0;
+    }
+
+    // Tool mode: Vector_Map --validate <source.shp> <target.shp> repairs every feature
+    // (orientation, duplicate and collinear points, closing, self-intersections) and writes
+    // the result, the .dbf is copied unchanged
+    if (argc == 4 && strcmp(argv[1], "--validate") == 0)
+    {
+        JobSystem *validateJobs = CreateJobSystem(0);
+        ValidationStats stats;
+        Layer repaired = RepairLayer(LoadLayer(argv[2]), validateJobs, &stats);
+        DestroyJobSystem(validateJobs);
+
+        cout << stats.features << " features, " << stats.invalidFeatures << " repaired" << endl;
+        cout << "  duplicate points removed:  " << stats.duplicatePoints << endl;
+        cout << "  collinear points removed:  " << stats.collinearPoints << endl;
+        cout << "  unclosed rings closed:     " << stats.unclosedRings << endl;
+        cout << "  self-intersections split:  " << stats.selfIntersections << endl;
+        cout << "  rings reversed:            " << stats.reversedRings << endl;
+        cout << "  degenerate parts dropped:  " << stats.droppedParts << endl;
+
+        bool written = WriteLayerShapefile(repaired, argv[2], argv[3]);
+        cout << (written ? "Wrote " : "Failed to write ") << argv[3] << endl;
+        return written ? 0 : 1;
+    }
+
+    // Tool mode: Vector_Map --overlay <source.shp> <clip.shp> <target.shp> [operation] combines
+    // every polygon of the source with the dissolved clip layer; the operation is one of
+    // intersection (default), union, difference or xor
+    if ((argc == 5 || argc == 6) && strcmp(argv[1], "--overlay") == 0)
+    {
+        const char *operationName = (argc == 6) ? argv[5] : "intersection";
+        ClipOperation operation = CLIP_INTERSECTION;
+        if (strcmp(operationName, "union") == 0) operation = CLIP_UNION;
+        else if (strcmp(operationName, "difference") == 0) operation = CLIP_DIFFERENCE;
+        else if (strcmp(operationName, "xor") == 0) operation = CLIP_XOR;
+
+        Layer source = LoadLayer(argv[2]);
+        Layer clipLayer = LoadLayer(argv[3]);
+        if (!IsPolygonType(source.shapeType) || !IsPolygonType(clipLayer.shapeType))
+        {
+            cout << "Overlay needs two polygon layers" << endl;
+            return 1;
+        }
+
+        vector<PartPoints> clip;
+        DissolveLayer(clipLayer, &clip);
+        JobSystem *overlayJobs = CreateJobSystem(0);
+        Layer result = OverlayLayer(source, clip, operation, overlayJobs);
+        DestroyJobSystem(overlayJobs);
+
+        bool written = WriteLayerShapefile(result, argv[2], argv[4]);
+        cout << (written ? "Wrote " : "Failed to write ") << argv[4] << endl;
+        return written ? 0 : 1;
+    }
+
+    // Tool mode: Vector_Map --selftest [features] checks the index and geometry kernels
+    // against brute force on random layers and prints their timings, exit code 1 on a mismatch
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "--selftest") == 0)
+    {
+        int features = (argc == 3) ? atoi(argv[2]) : SELFTEST_FEATURES;
+        if (features < 1) features = SELFTEST_FEATURES;
+        Layer polygons = RandomPolygonLayer(features, 4.0*sqrt((double)features), SELFTEST_SEED);
+
+        int failures = SelfTestSpatialIndex(polygons, SELFTEST_QUERIES, SELFTEST_SEED + 1);
+        failures += SelfTestQuantize(polygons, SELFTEST_TILES, SELFTEST_SEED + 2);
+        JobSystem *selfTestJobs = CreateJobSystem(0);
+        failures += SelfTestPointsInPolygons(polygons, selfTestJobs, SELFTEST_SEED + 3);
+        DestroyJobSystem(selfTestJobs);
+
+        cout << (failures == 0 ? "Self-test passed" : "Self-test FAILED") << endl;
+        return (failures == 0) ? 0 : 1;
+    }
+
     // Initialization
     //--------------------------------------------------------------------------------------
     const int screenWidth = 1280;
     const int screenHeight = 908;
-    float rotation = 0.0f;
 
+    // Vector_Map <layer.shp> [field] [projection] [fill], the projection is one of geographic,
+    // equirectangular (default), mercator, utm or tm, see ProjectionFromName. The layer is
+    // reprojected from the coordinate system in its .prj once and kept in <layer.shp>.cache
+    // until the shapefile, the .prj or the projection change. The fill is earcut (default)
+    // or delaunay for sliver-free triangles on large polygons.
+    const char *layerFile = (argc > 1) ? argv[1] : DEFAULT_LAYER;
+    const char *projectionName = (argc > 3) ? argv[3] : "equirectangular";
+    FillMethod fillMethod = FillMethodFromName((argc > 4) ? argv[4] : NULL);
+    JobSystem *jobs = CreateJobSystem(0);
+    CoordinateSystem sourceCrs;
+    if (!LoadPrj(layerFile, &sourceCrs)) cout << "Unsupported coordinate system in the .prj of " << layerFile << ", read as WGS 84" << endl;
+
+    string cacheFile = string(layerFile) + LAYER_CACHE_EXTENSION;
+    string cacheKey = LayerCacheKey(layerFile, projectionName);
+    Layer layer;
+    Projection projection;
+    if (!LoadLayerCache(cacheFile.c_str(), cacheKey, &layer, &projection))
+    {
+        layer = LoadLayer(layerFile);
+        projection = ProjectionFromName(projectionName, GeographicBounds(sourceCrs, layer.bounds));
+        TransformLayer(&layer, MakeCoordinateTransform(sourceCrs, projection), jobs);
+        MeasureLayer(&layer, jobs);
+        MeasureLayerGeodesic(&layer, projection, jobs);
+        if (layer.featureCount > 0) SaveLayerCache(cacheFile.c_str(), cacheKey, layer, projection);
+    }
+    CoordinateTransform transform = MakeCoordinateTransform(sourceCrs, projection);
+
+    // Geodesic measures for the HUD, looked up once; NULL when the layer has none (points)
+    auto measureColumn = [&layer](const char *name) -> const vector<double> * {
+        auto it = layer.columns.find(name);
+        return (it != layer.columns.end() && (int)it->second.size() == layer.featureCount) ? &it->second : NULL;
+    };
+    const vector<double> *geodesicArea = IsPolygonType(layer.shapeType) ? measureColumn(MEASURE_GEODESIC_AREA) : NULL;
+    const vector<double> *geodesicLength = IsPointType(layer.shapeType) ? NULL : measureColumn(MEASURE_GEODESIC_LENGTH);
+    MapView map = FitMapView(projection, layer.bounds, screenWidth, screenHeight);
+    auto mapToScreen = [&map](double x, double y) { return MapToScreen(map, x, y); };
+    SpatialIndex index = BuildLayerIndex(layer);
+    PointGrid grid = BuildPointGrid(IsPointType(layer.shapeType) ? layer : Layer(), POINT_GRID_POINTS_PER_CELL);
+    nEntities = layer.featureCount;
+    nShapeType = layer.shapeType;
+
+    // Simplified copies of the outlines, the coarsest level is within LOD_PIXEL_TOLERANCE at zoom 1.
+    // Tolerances are in map units, the map scale is the same on both axes.
+    double lodTolerance = LOD_PIXEL_TOLERANCE/(map.scale*LOD_MAX_ZOOM);
+    // Polygon levels come from shared arcs, so neighbours stay gap-free and every border
+    // is one line per level
+    LayerLod lod;
+    vector<Layer> borderLevels;
+    if (IsPolygonType(layer.shapeType)) lod = BuildTopologyLod(BuildTopology(layer), lodTolerance, LOD_LEVELS, jobs, &borderLevels);
+    else lod = BuildLayerLod(layer, lodTolerance, LOD_LEVELS, jobs);
+
+    // The camera works in the screen space of zoom 1. Geometry is drawn relative to its
+    // target (RelativeCamera, MapRenderFrame), so floats stay small at any zoom.
+    Camera2D camera = { 0 };
+    camera.zoom = 1.0f;
 
+    int picked = -1, pickedFill = -1;
+    vector<int> hits, visible;
+    vector<unsigned int> pickedTriangles;
+    vector<Vector2> pickedStrip;
 
     InitWindow(screenWidth, screenHeight, "raylib [shapes] example - basic shapes drawing");
     //SetTargetFPS(60);               // Set our game to run at 60 frames-per-second
+    // Fills stream in per tile from pool jobs, only visible tiles stay on the GPU. Tiles are
+    // simplified like the finest LOD level, which is below half a pixel up to LOD_MAX_ZOOM.
+    // Outline tiles hold the unsimplified lines of their cell and count against the same budget.
+    // Line layers stream outlines only, point layers are drawn from the layer and open no cache.
+    TileCache *tileCache = IsPointType(nShapeType) ? NULL : LoadTileCache(layerFile, TILE_CACHE_BUDGET, lodTolerance, transform, jobs, fillMethod, true);
+
+    // Outlines of the coarse LOD levels stay resident as GPU-widened line meshes with round
+    // joins; borders are open arcs, the round caps close them where they meet. The finer
+    // levels are only picked zoomed in, where few tiles are visible, and are drawn from the
+    // outline tiles at full resolution instead.
+    LineShader lineShader = LoadLineShader();
+    vector<LineMesh> levelLines;
+    for (int level = 0; !IsPointType(nShapeType) && level < LayerLodLevelCount(lod); level++)
+    {
+        if (tileCache != NULL && level < LOD_STREAMED_LEVELS) levelLines.push_back(LineMesh());
+        else levelLines.push_back(LoadLineMesh(borderLevels.empty() ? LayerLodLevel(lod, layer, level) : borderLevels[level], LINE_JOIN_ROUND));
+    }
+
+    // Fills and outlines are static, they are cached in render textures and only the
+    // picked feature, points and HUD are drawn every frame
+    LayerCompositor compositor = LoadLayerCompositor(screenWidth, screenHeight);
+    // Vector_Map <layer.shp> [field] labels features with a .dbf text field, the first one by default
+    vector<string> labelTexts;
+    LoadLabelTexts(layerFile, (argc > 2) ? argv[2] : NULL, &labelTexts);
+    LabelSet labels = BuildLabelSet(layer, labelTexts, mapToScreen, GetFontDefault(), LABEL_FONT_SIZE);
+
+    int fillLayer = AddCompositeLayer(&compositor, [&](const Camera2D &view) {
+        if (tileCache != NULL) DrawTileCache(*tileCache, MapRenderFrame(map, view), Color{ 40, 60, 90, 255 });
+    });
+    int outlineLayer = AddCompositeLayer(&compositor, [&](const Camera2D &view) {
+        if (levelLines.empty()) return;
+        int level = LayerLodSelect(lod, LOD_PIXEL_TOLERANCE/(map.scale*view.zoom));
+        float halfWidth = (float)(0.5*LINE_WIDTH/(map.scale*view.zoom));
+        Bounds viewBounds = CameraViewBounds(map, view, screenWidth, screenHeight);
+        if (tileCache != NULL && level < LOD_STREAMED_LEVELS) DrawTileCacheOutlines(*tileCache, MapRenderFrame(map, view), viewBounds, halfWidth, RAYWHITE);
+        else DrawLineMesh(levelLines[level], lineShader, MapRenderFrame(map, view), viewBounds, halfWidth, RAYWHITE);
+    });
     //--------------------------------------------------------------------------------------
     while (!WindowShouldClose())    // Detect window close button or ESC key
     {
         // Update
         //----------------------------------------------------------------------------------
-        rotation += 0.2f;
+        UpdateMapCamera(&camera);
+
+        // Pick the polygon under the cursor, otherwise the nearest feature within PICK_RADIUS
+        double mapX, mapY;
+        ScreenToMap(map, GetScreenToWorld2D(GetMousePosition(), camera), &mapX, &mapY);
+        double pickRadius = PICK_RADIUS/(map.scale*camera.zoom);
+        picked = -1;
+        if (IsPointType(nShapeType))
+        {
+            int slot = PointGridNearest(grid, mapX, mapY, pickRadius);
+            if (slot >= 0) picked = grid.ids[slot];
+        }
+        else
+        {
+            SpatialIndexPointInPolygon(index, layer, mapX, mapY, &hits);
+            if (!hits.empty()) picked = hits[0];
+            else
+            {
+                SpatialIndexNearest(index, layer, mapX, mapY, 1, pickRadius, &hits, NULL);
+                if (!hits.empty()) picked = hits[0];
+            }
+        }
+        if (picked != pickedFill)
+        {
+            pickedTriangles.clear();
+            if (picked >= 0 && IsPolygonType(nShapeType)) TriangulateFeature(layer, picked, &pickedTriangles, fillMethod);
+            pickedFill = picked;
+        }
+
+        // Only features whose box meets the viewport are submitted
+        Bounds view = CameraViewBounds(map, camera, screenWidth, screenHeight);
+        SpatialIndexSearch(index, view, &visible);
+        int level = LayerLodSelect(lod, LOD_PIXEL_TOLERANCE/(map.scale*camera.zoom));
+        bool streamedOutlines = !levelLines.empty() && level < LOD_STREAMED_LEVELS;
+        if (tileCache != NULL && UpdateTileCache(tileCache, view, streamedOutlines) > 0)
+        {
+            InvalidateCompositeLayer(&compositor, fillLayer);
+            if (streamedOutlines) InvalidateCompositeLayer(&compositor, outlineLayer);
+        }
+        UpdateLayerCompositor(&compositor, camera, GetFrameTime());
+
+        const Layer &outline = LayerLodLevel(lod, layer, level);
+        RenderFrame frame = MapRenderFrame(map, camera);
         //----------------------------------------------------------------------------------
         // Draw
         //----------------------------------------------------------------------------------
         BeginDrawing();
         ClearBackground(BLACK);
         //Draw
+        DrawCompositeLayer(compositor, fillLayer, camera);
+        BeginMode2D(RelativeCamera(camera));
+        // Screen space flips y, so the picked feature's triangles are reversed for DrawTriangle
+        for (int t = 0; t + 2 < (int)pickedTriangles.size(); t += 3)
+        {
+            DrawTriangle(RenderFramePoint(frame, layer.x[pickedTriangles[t]], layer.y[pickedTriangles[t]]),
+                         RenderFramePoint(frame, layer.x[pickedTriangles[t + 2]], layer.y[pickedTriangles[t + 2]]),
+                         RenderFramePoint(frame, layer.x[pickedTriangles[t + 1]], layer.y[pickedTriangles[t + 1]]), Color{ 120, 100, 30, 255 });
+        }
+        EndMode2D();
+        DrawCompositeLayer(compositor, outlineLayer, camera);
+        BeginMode2D(RelativeCamera(camera));
+        // Points draw one by one from the visible set. Parts keep their numbering at every
+        // level, so the picked feature owns the same parts in the outline level.
+        for (int k = 0; IsPointType(nShapeType) && k < (int)visible.size(); k++)
+        {
+            int f = visible[k];
+            Color color = (f == picked) ? YELLOW : RAYWHITE;
+            for (int i = layer.featurePart[f]; i < layer.featurePart[f + 1]; i++)
+            {
+                int v = layer.partStart[i];
+                DrawCircleV(RenderFramePoint(frame, layer.x[v], layer.y[v]), 2.0f/camera.zoom, color);
+            }
+        }
+        if (picked >= 0 && !IsPointType(nShapeType))
+        {
+            for (int i = outline.featurePart[picked]; i < outline.featurePart[picked + 1]; i++)
+            {
+                pickedStrip.clear();
+                for (int v = outline.partStart[i]; v < outline.partStart[i + 1]; v++) pickedStrip.push_back(RenderFramePoint(frame, outline.x[v], outline.y[v]));
+                DrawLineStrip(pickedStrip.data(), (int)pickedStrip.size(), YELLOW);
+            }
+        }
+        EndMode2D();
+        DrawLabels(&labels, camera, screenWidth, screenHeight, LIGHTGRAY);
+        double hudRadius = HUD_RADIUS/(map.scale*camera.zoom);
+        Bounds hud = { mapX - hudRadius, mapY - hudRadius, mapX + hudRadius, mapY + hudRadius };
+        int hudCount = IsPointType(nShapeType) ? PointGridCount(grid, hud) : SpatialIndexCount(index, hud);
+        DrawRectangleLines((int)(GetMouseX() - HUD_RADIUS), (int)(GetMouseY() - HUD_RADIUS), (int)(2*HUD_RADIUS), (int)(2*HUD_RADIUS), DARKGRAY);
+        DrawText(TextFormat("%i features here", hudCount), 100, 160, 20, LIGHTGRAY);
+        if (picked >= 0) DrawText(TextFormat("Feature %i (%s)", picked, SHPTypeName(nShapeType)), 100, 130, 20, YELLOW);
+        if (tileCache != NULL) DrawText(TextFormat("%i/%i tiles, %i KB", TileCacheLoadedCount(*tileCache), (int)tileCache->tiles.size(), (int)(tileCache->bytes >> 10)), 100, 190, 20, LIGHTGRAY);
+        if (picked >= 0 && geodesicArea != NULL && geodesicLength != NULL) DrawText(TextFormat("%.2f km2, %.2f km perimeter", (*geodesicArea)[picked]*1e-6, (*geodesicLength)[picked]*1e-3), 100, 220, 20, YELLOW);
+        else if (picked >= 0 && geodesicLength != NULL) DrawText(TextFormat("%.2f km", (*geodesicLength)[picked]*1e-3), 100, 220, 20, YELLOW);
+        DrawText(TextFormat("LOD %i, %i vertices", level, (int)LayerLodLevel(lod, layer, level).x.size()), 100, 250, 20, LIGHTGRAY);
+        DrawText(TextFormat("%i drawn, %i culled, %.2f ms", (int)visible.size(), nEntities - (int)visible.size(), GetFrameTime()*1000.0f), 100, 280, 20, LIGHTGRAY);
+        DrawText(TextFormat("%i layers re-rendered", compositor.renders), 100, 310, 20, LIGHTGRAY);
         DrawFPS(100, 100);
         EndDrawing();
         //----------------------------------------------------------------------------------
@@ -53,8 +478,13 @@ int main(void)
 
     // De-Initialization
     //--------------------------------------------------------------------------------------
+    UnloadLayerCompositor(&compositor);
+    for (int level = 0; level < (int)levelLines.size(); level++) UnloadLineMesh(&levelLines[level]);
+    UnloadLineShader(lineShader);
+    UnloadTileCache(tileCache);
+    DestroyJobSystem(jobs);
     CloseWindow();        // Close window and OpenGL context
     //--------------------------------------------------------------------------------------
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,347 @@
+#ifndef VECTORMAP_MEASURES_H
+#define VECTORMAP_MEASURES_H
+
+#include "Layer.h"
+#include "Projection.h"
+#include "JobSystem.h"
+#include <vector>
+#include <string>
+#include <math.h>
+
+#define MEASURE_FEATURES_PER_JOB 1024       // Features measured per job
+#define MEASURE_LANES 4                     // Independent accumulators per ring loop
+#define VINCENTY_ITERATIONS 100             // Longitude iterations before the spherical fallback
+
+#define MEASURE_AREA "area"                 // Map units squared, outer rings minus holes
+#define MEASURE_PERIMETER "perimeter"       // Map units, ring or line length
+#define MEASURE_CENTROID_X "centroid_x"     // Area centroid for polygons, length centroid for lines
+#define MEASURE_CENTROID_Y "centroid_y"
+#define MEASURE_MIN_X "min_x"
+#define MEASURE_MIN_Y "min_y"
+#define MEASURE_MAX_X "max_x"
+#define MEASURE_MAX_Y "max_y"
+#define MEASURE_VERTICES "vertices"
+#define MEASURE_GEODESIC_AREA "geodesic_area"       // Square metres on the ellipsoid
+#define MEASURE_GEODESIC_LENGTH "geodesic_length"   // Metres along geodesics
+
+//------------------------------------------------------------------------------------
+// Measures - per feature area, length, centroid, extent and vertex count for a layer
+//
+// Each ring or line is one pass over its contiguous x/y run. Coordinates are taken
+// relative to the part's first vertex (projected values are large and the cross
+// products would cancel), and the sums are split over MEASURE_LANES accumulators so
+// the loop carries no single dependency chain and the compiler can keep the lanes in
+// vector registers without reassociating. Features are measured in blocks on the
+// JobSystem and the results become layer columns, usable like any .dbf field.
+//
+// The geodesic variants unproject to longitude/latitude first. Lengths are Vincenty
+// inverse distances on the projection's ellipsoid. Areas are spherical excess on the
+// authalic sphere (latitudes mapped to authalic latitude, radius sqrt(qp/2)*a), which
+// keeps areas of the ellipsoid exact for zones and within a few ppm for polygons.
+//------------------------------------------------------------------------------------
+typedef struct PartMeasures {
+    double cross;       // Shoelace sum: twice the signed area, counter-clockwise positive
+    double sumX;        // Centroid moments relative to the part origin
+    double sumY;
+    double length;
+} PartMeasures;
+
+// One ring (closed or open, 'ring' adds the closing edge) or line, moments relative to its first vertex
+inline PartMeasures MeasurePart(const double *xs, const double *ys, int count, bool ring)
+{
+    PartMeasures m = { 0.0, 0.0, 0.0, 0.0 };
+    if (count < 2) return m;
+
+    double ox = xs[0], oy = ys[0];
+    double cross[MEASURE_LANES] = { 0 }, sumX[MEASURE_LANES] = { 0 }, sumY[MEASURE_LANES] = { 0 }, length[MEASURE_LANES] = { 0 };
+    int edges = count - 1, i = 0;
+
+    for (; i + MEASURE_LANES <= edges; i += MEASURE_LANES)
+    {
+        for (int k = 0; k < MEASURE_LANES; k++)
+        {
+            double x0 = xs[i + k] - ox, y0 = ys[i + k] - oy, x1 = xs[i + k + 1] - ox, y1 = ys[i + k + 1] - oy;
+            double c = x0*y1 - x1*y0;
+            cross[k] += c;
+            sumX[k] += (x0 + x1)*c;
+            sumY[k] += (y0 + y1)*c;
+            length[k] += sqrt((x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0));
+        }
+    }
+    for (; i < edges; i++)
+    {
+        double x0 = xs[i] - ox, y0 = ys[i] - oy, x1 = xs[i + 1] - ox, y1 = ys[i + 1] - oy;
+        double c = x0*y1 - x1*y0;
+        cross[0] += c;
+        sumX[0] += (x0 + x1)*c;
+        sumY[0] += (y0 + y1)*c;
+        length[0] += sqrt((x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0));
+    }
+
+    // The closing edge ends at the origin, its cross product is 0
+    if (ring && (xs[count - 1] != ox || ys[count - 1] != oy))
+    {
+        double dx = xs[count - 1] - ox, dy = ys[count - 1] - oy;
+        length[0] += sqrt(dx*dx + dy*dy);
+    }
+
+    for (int k = 0; k < MEASURE_LANES; k++)
+    {
+        m.cross += cross[k];
+        m.sumX += sumX[k];
+        m.sumY += sumY[k];
+        m.length += length[k];
+    }
+    return m;
+}
+
+typedef struct FeatureMeasures {
+    double area;
+    double perimeter;
+    double centroidX;
+    double centroidY;
+    int vertices;
+} FeatureMeasures;
+
+// Planar measures of one feature in map units
+inline FeatureMeasures MeasureFeature(const Layer &layer, int feature)
+{
+    FeatureMeasures m = { 0.0, 0.0, NAN, NAN, 0 };
+    bool polygon = IsPolygonType(layer.shapeType), line = IsLineType(layer.shapeType);
+    double cross = 0.0, momentX = 0.0, momentY = 0.0, weight = 0.0, pointX = 0.0, pointY = 0.0;
+
+    for (int p = layer.featurePart[feature]; p < layer.featurePart[feature + 1]; p++)
+    {
+        int first = layer.partStart[p], count = layer.partStart[p + 1] - first;
+        const double *xs = layer.x.data() + first, *ys = layer.y.data() + first;
+        m.vertices += count;
+        if (count == 0) continue;
+
+        if (!polygon && !line)
+        {
+            for (int v = 0; v < count; v++)
+            {
+                pointX += xs[v];
+                pointY += ys[v];
+            }
+            continue;
+        }
+
+        PartMeasures part = MeasurePart(xs, ys, count, polygon);
+        m.perimeter += part.length;
+        if (polygon)
+        {
+            // Moments about the part origin moved to the first part's origin (xs[0] there)
+            double dx = xs[0] - layer.x[layer.partStart[layer.featurePart[feature]]];
+            double dy = ys[0] - layer.y[layer.partStart[layer.featurePart[feature]]];
+            cross += part.cross;
+            momentX += part.sumX + 3.0*dx*part.cross;
+            momentY += part.sumY + 3.0*dy*part.cross;
+        }
+        else
+        {
+            // Length centroid: every segment weighs its length at its midpoint
+            for (int v = 0; v + 1 < count; v++)
+            {
+                double len = sqrt((xs[v + 1] - xs[v])*(xs[v + 1] - xs[v]) + (ys[v + 1] - ys[v])*(ys[v + 1] - ys[v]));
+                momentX += 0.5*(xs[v] + xs[v + 1])*len;
+                momentY += 0.5*(ys[v] + ys[v + 1])*len;
+                weight += len;
+            }
+        }
+    }
+
+    if (m.vertices == 0) return m;
+    if (polygon)
+    {
+        // Holes wind against their outer ring, so the sum is already outer minus holes
+        m.area = fabs(0.5*cross);
+        int origin = layer.partStart[layer.featurePart[feature]];
+        if (cross != 0.0)
+        {
+            m.centroidX = layer.x[origin] + momentX/(3.0*cross);
+            m.centroidY = layer.y[origin] + momentY/(3.0*cross);
+        }
+    }
+    else if (line && weight > 0.0)
+    {
+        m.centroidX = momentX/weight;
+        m.centroidY = momentY/weight;
+    }
+    else if (!line)
+    {
+        m.centroidX = pointX/m.vertices;
+        m.centroidY = pointY/m.vertices;
+    }
+    else
+    {
+        int origin = layer.partStart[layer.featurePart[feature]];
+        m.centroidX = layer.x[origin];
+        m.centroidY = layer.y[origin];
+    }
+
+    return m;
+}
+
+// Columns 'names' sized to the layer before jobs write into them
+inline std::vector<double *> MeasureColumns(Layer *layer, const char *const *names, int count)
+{
+    std::vector<double *> columns;
+    for (int i = 0; i < count; i++)
+    {
+        std::vector<double> &column = layer->columns[names[i]];
+        column.assign(layer->featureCount, NAN);
+        columns.push_back(column.data());
+    }
+    return columns;
+}
+
+// Planar measures of every feature as columns (MEASURE_AREA ... MEASURE_VERTICES)
+inline void MeasureLayer(Layer *layer, JobSystem *jobs = NULL)
+{
+    static const char *const names[] = { MEASURE_AREA, MEASURE_PERIMETER, MEASURE_CENTROID_X, MEASURE_CENTROID_Y,
+                                         MEASURE_MIN_X, MEASURE_MIN_Y, MEASURE_MAX_X, MEASURE_MAX_Y, MEASURE_VERTICES };
+    std::vector<double *> columns = MeasureColumns(layer, names, 9);
+
+    const Layer &source = *layer;
+    auto body = [&source, &columns](int first, int last) {
+        for (int f = first; f < last; f++)
+        {
+            FeatureMeasures m = MeasureFeature(source, f);
+            const Bounds &b = source.featureBounds[f];
+            bool empty = BoundsIsEmpty(b);
+            columns[0][f] = m.area;
+            columns[1][f] = m.perimeter;
+            columns[2][f] = m.centroidX;
+            columns[3][f] = m.centroidY;
+            columns[4][f] = empty ? NAN : b.minX;
+            columns[5][f] = empty ? NAN : b.minY;
+            columns[6][f] = empty ? NAN : b.maxX;
+            columns[7][f] = empty ? NAN : b.maxY;
+            columns[8][f] = m.vertices;
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, layer->featureCount, MEASURE_FEATURES_PER_JOB, body);
+    else body(0, layer->featureCount);
+}
+
+// Vincenty's inverse formula: metres between two points in degrees along the geodesic.
+// Nearly antipodal points, where it does not converge, fall back to the great circle on
+// the mean radius.
+inline double GeodesicDistance(const Ellipsoid &ellipsoid, double lon1, double lat1, double lon2, double lat2)
+{
+    double a = ellipsoid.a, f = ellipsoid.f, b = a*(1.0 - f);
+    double L = (lon2 - lon1)*PROJECTION_DEG2RAD;
+    double U1 = atan((1.0 - f)*tan(lat1*PROJECTION_DEG2RAD)), U2 = atan((1.0 - f)*tan(lat2*PROJECTION_DEG2RAD));
+    double sinU1 = sin(U1), cosU1 = cos(U1), sinU2 = sin(U2), cosU2 = cos(U2);
+
+    double lambda = L, sinSigma = 0.0, cosSigma = 0.0, sigma = 0.0, cos2Alpha = 0.0, cos2SigmaM = 0.0;
+    int i = 0;
+    for (; i < VINCENTY_ITERATIONS; i++)
+    {
+        double sinLambda = sin(lambda), cosLambda = cos(lambda);
+        double t1 = cosU2*sinLambda, t2 = cosU1*sinU2 - sinU1*cosU2*cosLambda;
+        sinSigma = sqrt(t1*t1 + t2*t2);
+        if (sinSigma == 0.0) return 0.0;
+        cosSigma = sinU1*sinU2 + cosU1*cosU2*cosLambda;
+        sigma = atan2(sinSigma, cosSigma);
+        double sinAlpha = cosU1*cosU2*sinLambda/sinSigma;
+        cos2Alpha = 1.0 - sinAlpha*sinAlpha;
+        cos2SigmaM = (cos2Alpha != 0.0) ? cosSigma - 2.0*sinU1*sinU2/cos2Alpha : 0.0;
+        double C = f/16.0*cos2Alpha*(4.0 + f*(4.0 - 3.0*cos2Alpha));
+        double previous = lambda;
+        lambda = L + (1.0 - C)*f*sinAlpha*(sigma + C*sinSigma*(cos2SigmaM + C*cosSigma*(-1.0 + 2.0*cos2SigmaM*cos2SigmaM)));
+        if (fabs(lambda - previous) < 1e-12) break;
+    }
+
+    if (i == VINCENTY_ITERATIONS)
+    {
+        double p1 = lat1*PROJECTION_DEG2RAD, p2 = lat2*PROJECTION_DEG2RAD;
+        double h = sin(0.5*(p2 - p1))*sin(0.5*(p2 - p1)) + cos(p1)*cos(p2)*sin(0.5*L)*sin(0.5*L);
+        return (2.0*a + b)/3.0*2.0*asin(fmin(1.0, sqrt(h)));
+    }
+
+    double u2 = cos2Alpha*(a*a - b*b)/(b*b);
+    double A = 1.0 + u2/16384.0*(4096.0 + u2*(-768.0 + u2*(320.0 - 175.0*u2)));
+    double B = u2/1024.0*(256.0 + u2*(-128.0 + u2*(74.0 - 47.0*u2)));
+    double deltaSigma = B*sinSigma*(cos2SigmaM + B/4.0*(cosSigma*(-1.0 + 2.0*cos2SigmaM*cos2SigmaM) -
+                        B/6.0*cos2SigmaM*(-3.0 + 4.0*sinSigma*sinSigma)*(-3.0 + 4.0*cos2SigmaM*cos2SigmaM)));
+    return b*A*(sigma - deltaSigma);
+}
+
+// q(phi) of the authalic latitude, sin(beta) = q/qp
+inline double AuthalicQ(double e, double sinPhi)
+{
+    if (e == 0.0) return 2.0*sinPhi;
+    double es = e*sinPhi;
+    return (1.0 - e*e)*(sinPhi/(1.0 - es*es) - 0.5/e*log((1.0 - es)/(1.0 + es)));
+}
+
+// Signed spherical excess of a ring (radians) on the authalic sphere, counter-clockwise
+// positive; times the authalic radius squared it is the area
+inline double AuthalicRingExcess(const Ellipsoid &ellipsoid, const double *lon, const double *lat, int count)
+{
+    double e = sqrt(ellipsoid.f*(2.0 - ellipsoid.f));
+    double qp = AuthalicQ(e, 1.0);
+    double excess = 0.0;
+
+    // Each edge adds the signed excess of the triangle it forms with the pole
+    double t1 = tan(0.5*asin(fmax(-1.0, fmin(1.0, AuthalicQ(e, sin(lat[count - 1]*PROJECTION_DEG2RAD))/qp))));
+    for (int i = 0, j = count - 1; i < count; j = i++)
+    {
+        double t2 = tan(0.5*asin(fmax(-1.0, fmin(1.0, AuthalicQ(e, sin(lat[i]*PROJECTION_DEG2RAD))/qp))));
+        double dl = remainder(lon[i] - lon[j], 360.0)*PROJECTION_DEG2RAD;
+        excess += 2.0*atan2(tan(0.5*dl)*(t1 + t2), 1.0 + t1*t2);
+        t1 = t2;
+    }
+    return excess;
+}
+
+inline double AuthalicRadius(const Ellipsoid &ellipsoid)
+{
+    double e = sqrt(ellipsoid.f*(2.0 - ellipsoid.f));
+    return ellipsoid.a*sqrt(0.5*AuthalicQ(e, 1.0));
+}
+
+// Geodesic area (polygons) and length (rings or lines) of every feature as the
+// MEASURE_GEODESIC_AREA and MEASURE_GEODESIC_LENGTH columns, 'projection' maps the
+// layer's coordinates back to degrees
+inline void MeasureLayerGeodesic(Layer *layer, const Projection &projection, JobSystem *jobs = NULL)
+{
+    static const char *const names[] = { MEASURE_GEODESIC_AREA, MEASURE_GEODESIC_LENGTH };
+    std::vector<double *> columns = MeasureColumns(layer, names, 2);
+
+    const Layer &source = *layer;
+    bool polygon = IsPolygonType(source.shapeType), line = IsLineType(source.shapeType);
+    double radius = AuthalicRadius(projection.ellipsoid);
+
+    auto body = [&](int first, int last) {
+        std::vector<double> lon, lat;
+        for (int f = first; f < last; f++)
+        {
+            double excess = 0.0, length = 0.0;
+            for (int p = source.featurePart[f]; (polygon || line) && p < source.featurePart[f + 1]; p++)
+            {
+                int start = source.partStart[p], count = source.partStart[p + 1] - start;
+                if (count < 2) continue;
+                lon.resize(count);
+                lat.resize(count);
+                ProjectInverse(projection, source.x.data() + start, source.y.data() + start, lon.data(), lat.data(), count);
+
+                // The closing vertex adds a zero length edge and no excess
+                for (int v = 0; v + 1 < count; v++) length += GeodesicDistance(projection.ellipsoid, lon[v], lat[v], lon[v + 1], lat[v + 1]);
+                if (polygon)
+                {
+                    length += GeodesicDistance(projection.ellipsoid, lon[count - 1], lat[count - 1], lon[0], lat[0]);
+                    excess += AuthalicRingExcess(projection.ellipsoid, lon.data(), lat.data(), count);
+                }
+            }
+            columns[0][f] = polygon ? fabs(excess)*radius*radius : 0.0;
+            columns[1][f] = length;
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, source.featureCount, MEASURE_FEATURES_PER_JOB, body);
+    else body(0, source.featureCount);
+}
+
+#endif // VECTORMAP_MEASURES_H
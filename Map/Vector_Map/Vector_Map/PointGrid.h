@@ -0,0 +1,231 @@
+#ifndef VECTORMAP_POINT_GRID_H
+#define VECTORMAP_POINT_GRID_H
+
+#include "Layer.h"
+#include <vector>
+#include <math.h>
+
+#define POINT_GRID_POINTS_PER_CELL 16
+#define POINT_GRID_MAX_CELLS (1 << 22)
+
+//------------------------------------------------------------------------------------
+// PointGrid - uniform grid index for dense point layers
+//
+// Points are counting-sorted by row-major cell id. cellStart is the prefix sum of the
+// cell populations, so cell c owns points [cellStart[c], cellStart[c + 1]) and a run of
+// cells along one row is one contiguous range of the point arrays. Positions are kept
+// as interleaved floats relative to the grid origin, ready to be handed to the GPU;
+// queries answer against those stored positions.
+//------------------------------------------------------------------------------------
+typedef struct GridPoint {
+    float x;
+    float y;
+} GridPoint;
+
+typedef struct PointSpan {
+    int first;
+    int count;
+} PointSpan;
+
+typedef struct PointGrid {
+    Bounds bounds;
+    double originX;                 // World position of point coordinate (0, 0)
+    double originY;
+    int cellsX;
+    int cellsY;
+    double cellWidth;
+    double cellHeight;
+    std::vector<int> cellStart;     // cellsX*cellsY + 1 prefix sums
+    std::vector<GridPoint> points;  // Sorted by cell
+    std::vector<int> ids;           // Feature id of every sorted point
+} PointGrid;
+
+inline int PointGridClampX(const PointGrid &grid, double x)
+{
+    int cx = (int)((x - grid.bounds.minX)/grid.cellWidth);
+    return (cx < 0) ? 0 : ((cx >= grid.cellsX) ? grid.cellsX - 1 : cx);
+}
+
+inline int PointGridClampY(const PointGrid &grid, double y)
+{
+    int cy = (int)((y - grid.bounds.minY)/grid.cellHeight);
+    return (cy < 0) ? 0 : ((cy >= grid.cellsY) ? grid.cellsY - 1 : cy);
+}
+
+// Cell holding (x, y), positions outside the grid are clamped to the border cells
+inline int PointGridCellIndex(const PointGrid &grid, double x, double y)
+{
+    return PointGridClampY(grid, y)*grid.cellsX + PointGridClampX(grid, x);
+}
+
+// Build the grid from every vertex of a point or multipoint layer
+inline PointGrid BuildPointGrid(const Layer &layer, int pointsPerCell)
+{
+    PointGrid grid;
+    grid.bounds = layer.bounds;
+    grid.originX = layer.bounds.minX;
+    grid.originY = layer.bounds.minY;
+    grid.cellsX = 1;
+    grid.cellsY = 1;
+    grid.cellWidth = 1.0;
+    grid.cellHeight = 1.0;
+
+    int count = (int)layer.x.size();
+    if (count == 0 || BoundsIsEmpty(layer.bounds))
+    {
+        grid.cellStart.assign(2, 0);
+        return grid;
+    }
+
+    // Square-ish cells sized for the requested average population
+    double w = layer.bounds.maxX - layer.bounds.minX;
+    double h = layer.bounds.maxY - layer.bounds.minY;
+    if (pointsPerCell < 1) pointsPerCell = 1;
+    double cells = (double)count/pointsPerCell;
+    if (cells > POINT_GRID_MAX_CELLS) cells = POINT_GRID_MAX_CELLS;
+    if (w > 0.0 && h > 0.0)
+    {
+        // Each axis is clamped to the cell target, or a flat extent (fixes along one road)
+        // would ask for far more columns than there are cells
+        double side = sqrt(w*h/cells);
+        grid.cellsX = (int)fmin(fmax(ceil(w/side), 1.0), ceil(cells));
+        grid.cellsY = (int)fmin(fmax(ceil(h/side), 1.0), ceil(cells));
+    }
+    else if (w > 0.0) grid.cellsX = (int)ceil(cells);
+    else if (h > 0.0) grid.cellsY = (int)ceil(cells);
+    if (grid.cellsX < 1) grid.cellsX = 1;
+    if (grid.cellsY < 1) grid.cellsY = 1;
+    grid.cellWidth = (w > 0.0) ? w/grid.cellsX : 1.0;
+    grid.cellHeight = (h > 0.0) ? h/grid.cellsY : 1.0;
+
+    // Counting sort: histogram, exclusive prefix sum, scatter
+    int cellCount = grid.cellsX*grid.cellsY;
+    std::vector<int> cellOf(count);
+    grid.cellStart.assign(cellCount + 1, 0);
+    for (int i = 0; i < count; i++)
+    {
+        cellOf[i] = PointGridCellIndex(grid, layer.x[i], layer.y[i]);
+        grid.cellStart[cellOf[i] + 1]++;
+    }
+    for (int c = 0; c < cellCount; c++) grid.cellStart[c + 1] += grid.cellStart[c];
+
+    // Vertex -> feature map, each part of a point layer is a single vertex
+    std::vector<int> featureOf(count);
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        for (int v = layer.partStart[layer.featurePart[f]]; v < layer.partStart[layer.featurePart[f + 1]]; v++) featureOf[v] = f;
+    }
+
+    std::vector<int> cursor(grid.cellStart.begin(), grid.cellStart.end() - 1);
+    grid.points.resize(count);
+    grid.ids.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        int slot = cursor[cellOf[i]]++;
+        grid.points[slot].x = (float)(layer.x[i] - grid.originX);
+        grid.points[slot].y = (float)(layer.y[i] - grid.originY);
+        grid.ids[slot] = featureOf[i];
+    }
+
+    return grid;
+}
+
+// One contiguous point range per grid row touched by the box. Points in border cells
+// may fall outside the box, use PointGridCount/PointGridQuery for exact answers.
+inline void PointGridSpans(const PointGrid &grid, const Bounds &query, std::vector<PointSpan> *spans)
+{
+    spans->clear();
+    if (grid.points.empty() || !BoundsIntersect(grid.bounds, query)) return;
+
+    int x0 = PointGridClampX(grid, query.minX), x1 = PointGridClampX(grid, query.maxX);
+    int y0 = PointGridClampY(grid, query.minY), y1 = PointGridClampY(grid, query.maxY);
+
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        int first = grid.cellStart[cy*grid.cellsX + x0];
+        int last = grid.cellStart[cy*grid.cellsX + x1 + 1];
+        if (last > first)
+        {
+            PointSpan span = { first, last - first };
+            spans->push_back(span);
+        }
+    }
+}
+
+// Visit the points inside the box as slot ranges [first, last). Cells fully covered by
+// the box are reported whole, only cells cut by the box border test their points.
+template <typename Visitor>
+inline void PointGridVisit(const PointGrid &grid, const Bounds &query, Visitor visit)
+{
+    if (grid.points.empty() || !BoundsIntersect(grid.bounds, query)) return;
+
+    int x0 = PointGridClampX(grid, query.minX), x1 = PointGridClampX(grid, query.maxX);
+    int y0 = PointGridClampY(grid, query.minY), y1 = PointGridClampY(grid, query.maxY);
+    double qx0 = query.minX - grid.originX, qx1 = query.maxX - grid.originX;
+    double qy0 = query.minY - grid.originY, qy1 = query.maxY - grid.originY;
+
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        double cellMinY = grid.bounds.minY + cy*grid.cellHeight;
+        bool rowInside = (cellMinY >= query.minY) && (cellMinY + grid.cellHeight <= query.maxY);
+
+        for (int cx = x0; cx <= x1; cx++)
+        {
+            double cellMinX = grid.bounds.minX + cx*grid.cellWidth;
+            bool inside = rowInside && (cellMinX >= query.minX) && (cellMinX + grid.cellWidth <= query.maxX);
+            int c = cy*grid.cellsX + cx;
+
+            if (inside)
+            {
+                visit(grid.cellStart[c], grid.cellStart[c + 1]);
+                continue;
+            }
+
+            for (int i = grid.cellStart[c]; i < grid.cellStart[c + 1]; i++)
+            {
+                const GridPoint &p = grid.points[i];
+                if (p.x >= qx0 && p.x <= qx1 && p.y >= qy0 && p.y <= qy1) visit(i, i + 1);
+            }
+        }
+    }
+}
+
+// Number of points inside the box, fully covered cells are counted from the prefix sums
+inline int PointGridCount(const PointGrid &grid, const Bounds &query)
+{
+    int count = 0;
+    PointGridVisit(grid, query, [&count](int first, int last) { count += last - first; });
+    return count;
+}
+
+// Sorted point slots inside the box
+inline void PointGridQuery(const PointGrid &grid, const Bounds &query, std::vector<int> *result)
+{
+    result->clear();
+    PointGridVisit(grid, query, [result](int first, int last) { for (int i = first; i < last; i++) result->push_back(i); });
+}
+
+// Slot of the closest point within radius of (x, y), -1 when there is none
+inline int PointGridNearest(const PointGrid &grid, double x, double y, double radius)
+{
+    Bounds query = { x - radius, y - radius, x + radius, y + radius };
+    double bestSq = radius*radius;
+    int best = -1;
+
+    PointGridVisit(grid, query, [&](int first, int last) {
+        for (int i = first; i < last; i++)
+        {
+            double dx = grid.points[i].x + grid.originX - x;
+            double dy = grid.points[i].y + grid.originY - y;
+            if (dx*dx + dy*dy <= bestSq)
+            {
+                bestSq = dx*dx + dy*dy;
+                best = i;
+            }
+        }
+    });
+
+    return best;
+}
+
+#endif // VECTORMAP_POINT_GRID_H
@@ -0,0 +1,375 @@
+#ifndef VECTORMAP_POINT_IN_POLYGON_H
+#define VECTORMAP_POINT_IN_POLYGON_H
+
+#include "Layer.h"
+#include "SpatialIndex.h"
+#include "SpatialJoin.h"
+#include "JobSystem.h"
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
+
+#define PIP_EDGES_PER_SLAB 8            // Target edges per y-slab of a polygon
+#define PIP_MAX_SLABS 4096              // Slabs per polygon at most
+#define PIP_FEATURES_PER_JOB 64         // Polygons bucketed per job while building
+#define PIP_POINTS_PER_JOB 4096         // Hilbert-ordered points classified per job
+
+//------------------------------------------------------------------------------------
+// PointInPolygon - batched point-in-polygon tests of many points against many polygons
+//
+// Every polygon is cut into horizontal slabs of equal height over its box, about
+// PIP_EDGES_PER_SLAB edges each, and every edge is stored (as flat x/y arrays) in each
+// slab its y range touches. A horizontal ray from a point can only cross the edges of the
+// point's own slab, so a test reads a handful of edges instead of the whole polygon.
+//
+// Batches go polygon by polygon: the points inside the polygon's box are counting-sorted
+// by slab, then each slab's points go two per SSE2 step through its edges, the crossing
+// flags xored into a parity register without branches. The crossing test is PointInRing's
+// term for term and the parity runs over all rings of the feature, so holes and
+// multi-part polygons give exactly FeatureContainsPoint's answer.
+//
+// Large point sets are Hilbert-sorted first and split into blocks; each block asks the
+// R-tree for the polygons under its box, which stay few because the block is compact.
+//------------------------------------------------------------------------------------
+typedef struct PipIndex {
+    int featureCount;
+    std::vector<Bounds> bounds;             // Feature boxes, empty for non-polygons
+    std::vector<int> firstSlab;             // featureCount + 1 offsets into slabStart
+    std::vector<double> slabScale;          // Slabs per map unit of y, per feature
+    std::vector<int> slabStart;             // Offsets into the edge arrays, one past the last slab
+    std::vector<double> xi, yi;             // Edge end (current vertex in PointInRing)
+    std::vector<double> xj, yj;             // Edge start (previous vertex)
+    SpatialIndex index;
+} PipIndex;
+
+// Per worker buffers of a batch
+typedef struct PipBatch {
+    std::vector<int> candidates;            // Polygons under the block box
+    std::vector<int> selected;              // Points inside the polygon box, by slab
+    std::vector<int> slabCounts;
+    std::vector<int> slabOf;
+    std::vector<double> x, y;               // Selected points in slab order
+    std::vector<unsigned char> inside;
+    std::vector<unsigned char> result;      // Per point of the block
+} PipBatch;
+
+// Slab of y in feature f, y inside the feature box. Monotonic in y, so an edge spanning
+// [y0, y1] lies in every slab from PipSlab(y0) to PipSlab(y1).
+inline int PipSlab(const PipIndex &index, int f, double y)
+{
+    int slabs = index.firstSlab[f + 1] - index.firstSlab[f];
+    int s = (int)((y - index.bounds[f].minY)*index.slabScale[f]);
+    return (s < slabs - 1) ? s : slabs - 1;
+}
+
+// Slab count and bucketed edge count of feature f, before the slabs exist
+inline void PipFeatureSize(const Layer &layer, int f, int *slabs, double *scale, int *entries)
+{
+    const Bounds &b = layer.featureBounds[f];
+    int edges = layer.partStart[layer.featurePart[f + 1]] - layer.partStart[layer.featurePart[f]];
+    int count = edges/PIP_EDGES_PER_SLAB;
+    count = (count < 1) ? 1 : (count > PIP_MAX_SLABS) ? PIP_MAX_SLABS : count;
+    double height = b.maxY - b.minY;
+    if (!(height > 0.0)) count = 1;
+
+    *slabs = count;
+    *scale = (count > 1) ? count/height : 0.0;
+    *entries = 0;
+    for (int p = layer.featurePart[f]; p < layer.featurePart[f + 1]; p++)
+    {
+        int first = layer.partStart[p], n = layer.partStart[p + 1] - first;
+        for (int i = 0, j = n - 1; i < n; j = i++)
+        {
+            double y0 = layer.y[first + i], y1 = layer.y[first + j];
+            if (y0 == y1) continue;                     // Never straddles a ray
+            if (y0 > y1) std::swap(y0, y1);
+            int s0 = (int)((y0 - b.minY)*(*scale)), s1 = (int)((y1 - b.minY)*(*scale));
+            if (s0 > count - 1) s0 = count - 1;
+            if (s1 > count - 1) s1 = count - 1;
+            *entries += s1 - s0 + 1;
+        }
+    }
+}
+
+// Bucket the edges of every polygon feature of 'layer', jobs may be NULL
+inline PipIndex BuildPipIndex(const Layer &layer, JobSystem *jobs)
+{
+    PipIndex index;
+    int n = layer.featureCount;
+    index.featureCount = n;
+    index.bounds.assign(n, EmptyBounds());
+    index.firstSlab.assign(n + 1, 0);
+    index.slabScale.assign(n, 0.0);
+    if (!IsPolygonType(layer.shapeType)) return index;
+
+    std::vector<int> entries(n, 0), firstEntry(n + 1, 0);
+    auto size = [&](int first, int last) {
+        for (int f = first; f < last; f++)
+        {
+            index.bounds[f] = layer.featureBounds[f];
+            if (BoundsIsEmpty(layer.featureBounds[f])) continue;
+            PipFeatureSize(layer, f, &index.firstSlab[f + 1], &index.slabScale[f], &entries[f]);
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, n, PIP_FEATURES_PER_JOB, size);
+    else size(0, n);
+
+    for (int f = 0; f < n; f++)
+    {
+        index.firstSlab[f + 1] += index.firstSlab[f];
+        firstEntry[f + 1] = firstEntry[f] + entries[f];
+    }
+    index.slabStart.assign(index.firstSlab[n] + 1, 0);
+    index.slabStart[index.firstSlab[n]] = firstEntry[n];
+    index.xi.resize(firstEntry[n]);
+    index.yi.resize(firstEntry[n]);
+    index.xj.resize(firstEntry[n]);
+    index.yj.resize(firstEntry[n]);
+
+    auto fill = [&](int first, int last) {
+        std::vector<int> cursor;
+        for (int f = first; f < last; f++)
+        {
+            int slabs = index.firstSlab[f + 1] - index.firstSlab[f];
+            if (slabs == 0) continue;
+
+            // Count per slab, then place each edge in every slab of its y range
+            cursor.assign(slabs + 1, 0);
+            for (int pass = 0; pass < 2; pass++)
+            {
+                for (int p = layer.featurePart[f]; p < layer.featurePart[f + 1]; p++)
+                {
+                    int start = layer.partStart[p], count = layer.partStart[p + 1] - start;
+                    for (int i = 0, j = count - 1; i < count; j = i++)
+                    {
+                        double yi = layer.y[start + i], yj = layer.y[start + j];
+                        if (yi == yj) continue;
+                        int s0 = PipSlab(index, f, (yi < yj) ? yi : yj), s1 = PipSlab(index, f, (yi < yj) ? yj : yi);
+                        for (int s = s0; s <= s1; s++)
+                        {
+                            if (pass == 0) { cursor[s + 1]++; continue; }
+                            int e = cursor[s]++;
+                            index.xi[e] = layer.x[start + i];
+                            index.yi[e] = yi;
+                            index.xj[e] = layer.x[start + j];
+                            index.yj[e] = yj;
+                        }
+                    }
+                }
+                if (pass == 1) break;
+
+                cursor[0] = firstEntry[f];
+                for (int s = 0; s < slabs; s++) cursor[s + 1] += cursor[s];
+                for (int s = 0; s < slabs; s++) index.slabStart[index.firstSlab[f] + s] = cursor[s];
+            }
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, n, PIP_FEATURES_PER_JOB, fill);
+    else fill(0, n);
+
+    index.index = BuildLayerIndex(layer);
+    return index;
+}
+
+// Flip inside[k] for every point whose ray to +x crosses one of the edges. Two points
+// run per SSE2 step through all edges of the slab with the parity kept in a register;
+// the lane arithmetic is the scalar test's, so results match it bit for bit.
+inline void PipCrossEdges(const PipIndex &index, int firstEdge, int lastEdge, const double *px, const double *py, int count, unsigned char *inside)
+{
+    const double *xi = index.xi.data(), *yi = index.yi.data(), *xj = index.xj.data(), *yj = index.yj.data();
+    int k = 0;
+    for (; k + 2 <= count; k += 2)
+    {
+        __m128d x = _mm_loadu_pd(px + k), y = _mm_loadu_pd(py + k);
+        __m128d parity = _mm_setzero_pd();
+        for (int e = firstEdge; e < lastEdge; e++)
+        {
+            __m128d ax = _mm_set1_pd(xi[e]), ay = _mm_set1_pd(yi[e]), by = _mm_set1_pd(yj[e]);
+            __m128d straddles = _mm_xor_pd(_mm_cmpgt_pd(ay, y), _mm_cmpgt_pd(by, y));
+            __m128d cross = _mm_add_pd(_mm_div_pd(_mm_mul_pd(_mm_set1_pd(xj[e] - xi[e]), _mm_sub_pd(y, ay)), _mm_set1_pd(yj[e] - yi[e])), ax);
+            parity = _mm_xor_pd(parity, _mm_and_pd(straddles, _mm_cmplt_pd(x, cross)));
+        }
+        int mask = _mm_movemask_pd(parity);
+        inside[k] ^= (unsigned char)(mask & 1);
+        inside[k + 1] ^= (unsigned char)((mask >> 1) & 1);
+    }
+    for (; k < count; k++)
+    {
+        for (int e = firstEdge; e < lastEdge; e++)
+        {
+            if (((yi[e] > py[k]) != (yj[e] > py[k])) &&
+                (px[k] < (xj[e] - xi[e])*(py[k] - yi[e])/(yj[e] - yi[e]) + xi[e])) inside[k] ^= 1;
+        }
+    }
+}
+
+// Single point test against feature f, same answer as FeatureContainsPoint
+inline bool PipContains(const PipIndex &index, int f, double x, double y)
+{
+    if (index.firstSlab[f + 1] == index.firstSlab[f] || !BoundsContainsPoint(index.bounds[f], x, y)) return false;
+    int slab = index.firstSlab[f] + PipSlab(index, f, y);
+    unsigned char inside = 0;
+    PipCrossEdges(index, index.slabStart[slab], index.slabStart[slab + 1], &x, &y, 1, &inside);
+    return inside != 0;
+}
+
+// Classify count points against feature f, inside[k] becomes 1 or 0
+inline void PipClassifyPoints(const PipIndex &index, int f, const double *px, const double *py, int count,
+                              unsigned char *inside, PipBatch *batch)
+{
+    std::fill(inside, inside + count, (unsigned char)0);
+    int slabs = index.firstSlab[f + 1] - index.firstSlab[f];
+    if (slabs == 0) return;
+
+    // Counting sort of the points in the box by slab
+    const Bounds &b = index.bounds[f];
+    batch->slabCounts.assign(slabs + 1, 0);
+    batch->slabOf.resize(count);
+    int selected = 0;
+    for (int k = 0; k < count; k++)
+    {
+        int s = -1;
+        if (BoundsContainsPoint(b, px[k], py[k]))
+        {
+            s = PipSlab(index, f, py[k]);
+            batch->slabCounts[s + 1]++;
+            selected++;
+        }
+        batch->slabOf[k] = s;
+    }
+    if (selected == 0) return;
+
+    for (int s = 0; s < slabs; s++) batch->slabCounts[s + 1] += batch->slabCounts[s];
+    batch->selected.resize(selected);
+    batch->x.resize(selected);
+    batch->y.resize(selected);
+    batch->inside.assign(selected, 0);
+    std::vector<int> &cursor = batch->slabCounts;
+    for (int k = 0; k < count; k++)
+    {
+        int s = batch->slabOf[k];
+        if (s < 0) continue;
+        int slot = cursor[s]++;
+        batch->selected[slot] = k;
+        batch->x[slot] = px[k];
+        batch->y[slot] = py[k];
+    }
+
+    // cursor[s] now ends slab s, which is where slab s + 1 starts
+    for (int s = 0, first = 0; s < slabs; first = cursor[s], s++)
+    {
+        int last = cursor[s];
+        if (last == first) continue;
+        int slab = index.firstSlab[f] + s;
+        PipCrossEdges(index, index.slabStart[slab], index.slabStart[slab + 1],
+                      batch->x.data() + first, batch->y.data() + first, last - first, batch->inside.data() + first);
+    }
+
+    for (int k = 0; k < selected; k++) inside[batch->selected[k]] = batch->inside[k];
+}
+
+// Every (point, polygon) containment among count points, visit(k, f) is called per pair
+// in no particular order. The points should be spatially compact for the box query to pay.
+template <typename Visit>
+inline void PipVisitPoints(const PipIndex &index, const double *px, const double *py, int count, PipBatch *batch, Visit visit)
+{
+    if (count == 0) return;
+    Bounds box = EmptyBounds();
+    for (int k = 0; k < count; k++) BoundsExtend(&box, px[k], py[k]);
+
+    SpatialIndexSearch(index.index, box, &batch->candidates);
+    batch->result.resize(count);
+    for (int c = 0; c < (int)batch->candidates.size(); c++)
+    {
+        int f = batch->candidates[c];
+        PipClassifyPoints(index, f, px, py, count, batch->result.data(), batch);
+        for (int k = 0; k < count; k++) if (batch->result[k]) visit(k, f);
+    }
+}
+
+// Point order along a Hilbert curve over the points' extent
+inline std::vector<int> PipHilbertOrder(const double *px, const double *py, int count)
+{
+    Bounds extent = EmptyBounds();
+    for (int k = 0; k < count; k++) BoundsExtend(&extent, px[k], py[k]);
+
+    // Key in the high half, index in the low one: a plain sort of 64-bit values
+    std::vector<unsigned long long> keys(count);
+    for (int k = 0; k < count; k++) keys[k] = ((unsigned long long)HilbertIndexInBounds(extent, px[k], py[k]) << 32) | (unsigned int)k;
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> order(count);
+    for (int k = 0; k < count; k++) order[k] = (int)(keys[k] & 0xFFFFFFFFu);
+    return order;
+}
+
+// Run visit(block, k, f) for every containment, k being the original point index. Points
+// are Hilbert-ordered and classified in blocks of PIP_POINTS_PER_JOB on the JobSystem
+// (jobs may be NULL), one block per call at a time.
+template <typename Visit>
+inline void PipVisitBlocks(const PipIndex &index, const double *px, const double *py, int count, JobSystem *jobs, Visit visit)
+{
+    std::vector<int> order = PipHilbertOrder(px, py, count);
+    std::vector<double> sx(count), sy(count);
+    for (int k = 0; k < count; k++)
+    {
+        sx[k] = px[order[k]];
+        sy[k] = py[order[k]];
+    }
+
+    auto body = [&](int first, int last) {
+        PipBatch batch;
+        for (int block = first; block < last; block += PIP_POINTS_PER_JOB)
+        {
+            int end = (block + PIP_POINTS_PER_JOB < last) ? block + PIP_POINTS_PER_JOB : last;
+            PipVisitPoints(index, sx.data() + block, sy.data() + block, end - block, &batch,
+                           [&](int k, int f) { visit(block/PIP_POINTS_PER_JOB, order[block + k], f); });
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, count, PIP_POINTS_PER_JOB, body);
+    else body(0, count);
+}
+
+// zone[k] = lowest id of the polygons containing point k, -1 when none
+inline void PointsInPolygons(const PipIndex &index, const double *px, const double *py, int count, int *zone, JobSystem *jobs)
+{
+    std::fill(zone, zone + count, -1);
+    PipVisitBlocks(index, px, py, count, jobs, [zone](int, int k, int f) {
+        if (zone[k] < 0 || f < zone[k]) zone[k] = f;
+    });
+}
+
+// Every (point, polygon) containment as pairs sorted by point then polygon id
+inline std::vector<JoinPair> PointsInPolygonsPairs(const PipIndex &index, const double *px, const double *py, int count, JobSystem *jobs)
+{
+    std::vector<std::vector<JoinPair>> blocks((count + PIP_POINTS_PER_JOB - 1)/PIP_POINTS_PER_JOB);
+    PipVisitBlocks(index, px, py, count, jobs, [&blocks](int block, int k, int f) {
+        JoinPair pair = { k, f };
+        blocks[block].push_back(pair);
+    });
+
+    std::vector<JoinPair> pairs;
+    for (int b = 0; b < (int)blocks.size(); b++) pairs.insert(pairs.end(), blocks[b].begin(), blocks[b].end());
+    std::sort(pairs.begin(), pairs.end(), [](const JoinPair &a, const JoinPair &b) {
+        return (a.left != b.left) ? a.left < b.left : a.right < b.right;
+    });
+    return pairs;
+}
+
+// Coordinates of a layer whose features are single points, false for anything else
+inline bool LayerPointCoordinates(const Layer &layer, std::vector<double> *px, std::vector<double> *py)
+{
+    if (!IsPointType(layer.shapeType)) return false;
+    px->resize(layer.featureCount);
+    py->resize(layer.featureCount);
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        int first = layer.partStart[layer.featurePart[f]], last = layer.partStart[layer.featurePart[f + 1]];
+        if (last - first != 1) return false;
+        (*px)[f] = layer.x[first];
+        (*py)[f] = layer.y[first];
+    }
+    return true;
+}
+
+#endif // VECTORMAP_POINT_IN_POLYGON_H
@@ -0,0 +1,437 @@
+#ifndef VECTORMAP_PRJ_H
+#define VECTORMAP_PRJ_H
+
+#include "Layer.h"
+#include "Projection.h"
+#include "JobSystem.h"
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define ARCSEC2RAD (PROJECTION_DEG2RAD/3600.0)
+
+//------------------------------------------------------------------------------------
+// Prj - coordinate systems from .prj WKT and batch datum transformation
+//
+// The .prj next to a shapefile holds its coordinate system as WKT (ESRI or OGC flavour).
+// LoadPrj parses it into a CoordinateSystem: ellipsoid, prime meridian, angular and
+// linear units, a seven parameter Helmert shift to WGS84 (TOWGS84, or a small table of
+// well known datums for ESRI files that omit it) and, for PROJCS, the Projection. A
+// CoordinateTransform takes source coordinates to WGS84 degrees and on through a target
+// Projection: unproject, geodetic -> geocentric on the source ellipsoid, Helmert,
+// geocentric -> geodetic on WGS84, project. Every step runs over whole arrays, and
+// TransformLayer splits a layer into blocks on the JobSystem.
+//------------------------------------------------------------------------------------
+typedef struct WktNode {
+    std::string keyword;
+    std::vector<std::string> values;    // Quoted strings, numbers and bare words in order
+    std::vector<WktNode> children;
+} WktNode;
+
+typedef struct CoordinateSystem {
+    std::string name;
+    Ellipsoid ellipsoid;
+    double toWgs84[7];          // dx, dy, dz (m), rx, ry, rz (arc seconds), scale (ppm), position vector
+    bool datumShift;            // toWgs84 is not the identity
+    double primeMeridian;       // Degrees east of Greenwich
+    double angularUnit;         // Degrees per geographic unit
+    bool projected;
+    Projection projection;      // Valid when projected, in metres
+    double linearUnit;          // Metres per projected unit
+} CoordinateSystem;
+
+typedef struct CoordinateTransform {
+    CoordinateSystem source;
+    Projection target;          // Applied to WGS84 degrees
+} CoordinateTransform;
+
+// Datums ESRI writes without TOWGS84, matched on a fragment of the DATUM name
+typedef struct KnownDatum {
+    const char *name;
+    double toWgs84[7];
+} KnownDatum;
+
+static const KnownDatum KNOWN_DATUMS[] = {
+    { "european_1950", { -87.0, -98.0, -121.0, 0.0, 0.0, 0.0, 0.0 } },
+    { "ed50", { -87.0, -98.0, -121.0, 0.0, 0.0, 0.0, 0.0 } },
+    { "osgb_1936", { 446.448, -125.157, 542.06, 0.15, 0.247, 0.842, -20.489 } },
+    { "north_american_1927", { -8.0, 160.0, 176.0, 0.0, 0.0, 0.0, 0.0 } },
+    { "potsdam", { 598.1, 73.7, 418.2, 0.202, 0.045, -2.455, 6.7 } },
+};
+
+inline bool WktKeywordEquals(const std::string &a, const char *b)
+{
+    size_t n = strlen(b);
+    if (a.size() != n) return false;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+// Lower case with spaces turned into underscores, so ESRI and OGC names compare equal
+inline std::string WktNormalizeName(const std::string &name)
+{
+    std::string normalized(name);
+    for (size_t i = 0; i < normalized.size(); i++)
+    {
+        normalized[i] = (normalized[i] == ' ') ? '_' : (char)tolower((unsigned char)normalized[i]);
+    }
+    return normalized;
+}
+
+inline void WktSkipSpace(const char **cursor)
+{
+    while (**cursor != '\0' && isspace((unsigned char)**cursor)) (*cursor)++;
+}
+
+// KEYWORD[item, ...] where an item is a quoted string, a number, a bare word or a node.
+// Round brackets are accepted too. Returns false on malformed input.
+inline bool ParseWktNode(const char **cursor, WktNode *node)
+{
+    WktSkipSpace(cursor);
+    const char *start = *cursor;
+    while (isalnum((unsigned char)**cursor) || **cursor == '_') (*cursor)++;
+    node->keyword.assign(start, *cursor - start);
+    WktSkipSpace(cursor);
+    if (node->keyword.empty() || (**cursor != '[' && **cursor != '(')) return false;
+    char close = (**cursor == '[') ? ']' : ')';
+    (*cursor)++;
+
+    for (;;)
+    {
+        WktSkipSpace(cursor);
+        if (**cursor == '"')
+        {
+            start = ++(*cursor);
+            while (**cursor != '\0' && **cursor != '"') (*cursor)++;
+            if (**cursor != '"') return false;
+            node->values.push_back(std::string(start, *cursor - start));
+            (*cursor)++;
+        }
+        else if (isdigit((unsigned char)**cursor) || **cursor == '-' || **cursor == '+' || **cursor == '.')
+        {
+            char *end = NULL;
+            strtod(*cursor, &end);
+            if (end == *cursor) return false;
+            node->values.push_back(std::string(*cursor, end - *cursor));
+            *cursor = end;
+        }
+        else
+        {
+            // A keyword followed by a bracket is a child node, otherwise a bare word (AXIS["X",EAST])
+            const char *word = *cursor;
+            while (isalnum((unsigned char)**cursor) || **cursor == '_') (*cursor)++;
+            if (*cursor == word) return false;
+            const char *after = *cursor;
+            WktSkipSpace(&after);
+            if (*after == '[' || *after == '(')
+            {
+                *cursor = word;
+                node->children.push_back(WktNode());
+                if (!ParseWktNode(cursor, &node->children.back())) return false;
+            }
+            else node->values.push_back(std::string(word, *cursor - word));
+        }
+
+        WktSkipSpace(cursor);
+        if (**cursor == ',') { (*cursor)++; continue; }
+        if (**cursor != close) return false;
+        (*cursor)++;
+        return true;
+    }
+}
+
+// First child with 'keyword', depth first when 'deep'
+inline const WktNode *WktFind(const WktNode &node, const char *keyword, bool deep)
+{
+    for (int i = 0; i < (int)node.children.size(); i++)
+    {
+        if (WktKeywordEquals(node.children[i].keyword, keyword)) return &node.children[i];
+    }
+    for (int i = 0; deep && i < (int)node.children.size(); i++)
+    {
+        const WktNode *found = WktFind(node.children[i], keyword, true);
+        if (found != NULL) return found;
+    }
+    return NULL;
+}
+
+inline double WktNumber(const WktNode *node, int value, double fallback)
+{
+    if (node == NULL || value >= (int)node->values.size()) return fallback;
+    return atof(node->values[value].c_str());
+}
+
+// PARAMETER["name", value] of a PROJCS, names compare case and space insensitive
+inline double WktParameter(const WktNode &projcs, const char *name, double fallback)
+{
+    for (int i = 0; i < (int)projcs.children.size(); i++)
+    {
+        const WktNode &child = projcs.children[i];
+        if (!WktKeywordEquals(child.keyword, "PARAMETER") || child.values.empty()) continue;
+        if (WktNormalizeName(child.values[0]) == name) return WktNumber(&child, 1, fallback);
+    }
+    return fallback;
+}
+
+// Geographic WGS84 in degrees, what a layer without .prj is taken to be
+inline CoordinateSystem Wgs84CoordinateSystem(void)
+{
+    CoordinateSystem crs;
+    crs.name = "WGS 84";
+    crs.ellipsoid = WGS84Ellipsoid();
+    for (int i = 0; i < 7; i++) crs.toWgs84[i] = 0.0;
+    crs.datumShift = false;
+    crs.primeMeridian = 0.0;
+    crs.angularUnit = 1.0;
+    crs.projected = false;
+    crs.projection = GeographicProjection();
+    crs.linearUnit = 1.0;
+    return crs;
+}
+
+// Fill a CoordinateSystem from WKT, false when it is malformed or uses an unsupported projection
+inline bool ParseCoordinateSystem(const char *wkt, CoordinateSystem *crs)
+{
+    *crs = Wgs84CoordinateSystem();
+
+    WktNode root;
+    const char *cursor = wkt;
+    if (!ParseWktNode(&cursor, &root)) return false;
+
+    bool projected = WktKeywordEquals(root.keyword, "PROJCS");
+    const WktNode *geogcs = projected ? WktFind(root, "GEOGCS", false) : &root;
+    if (geogcs == NULL || !WktKeywordEquals(geogcs->keyword, "GEOGCS")) return false;
+    if (!root.values.empty()) crs->name = root.values[0];
+
+    const WktNode *datum = WktFind(*geogcs, "DATUM", false);
+    const WktNode *spheroid = (datum != NULL) ? WktFind(*datum, "SPHEROID", false) : NULL;
+    if (spheroid != NULL)
+    {
+        double inverseFlattening = WktNumber(spheroid, 2, 0.0);
+        crs->ellipsoid.a = WktNumber(spheroid, 1, WGS84_A);
+        crs->ellipsoid.f = (inverseFlattening != 0.0) ? 1.0/inverseFlattening : 0.0;
+    }
+
+    const WktNode *towgs84 = (datum != NULL) ? WktFind(*datum, "TOWGS84", false) : NULL;
+    if (towgs84 != NULL)
+    {
+        for (int i = 0; i < 7; i++) crs->toWgs84[i] = WktNumber(towgs84, i, 0.0);
+    }
+    else if (datum != NULL && !datum->values.empty())
+    {
+        std::string name = WktNormalizeName(datum->values[0]);
+        for (int k = 0; k < (int)(sizeof(KNOWN_DATUMS)/sizeof(KNOWN_DATUMS[0])); k++)
+        {
+            if (name.find(KNOWN_DATUMS[k].name) == std::string::npos) continue;
+            for (int i = 0; i < 7; i++) crs->toWgs84[i] = KNOWN_DATUMS[k].toWgs84[i];
+            break;
+        }
+    }
+    for (int i = 0; i < 7; i++) crs->datumShift |= (crs->toWgs84[i] != 0.0);
+    crs->datumShift |= (crs->ellipsoid.a != WGS84_A || fabs(crs->ellipsoid.f - WGS84_F) > 1e-12);
+
+    // Angular unit is radians per unit, PRIMEM is in that unit
+    double angular = WktNumber(WktFind(*geogcs, "UNIT", false), 1, PROJECTION_DEG2RAD);
+    crs->angularUnit = angular*PROJECTION_RAD2DEG;
+    crs->primeMeridian = WktNumber(WktFind(*geogcs, "PRIMEM", false), 1, 0.0)*crs->angularUnit;
+    if (!projected) return true;
+
+    crs->projected = true;
+    crs->linearUnit = WktNumber(WktFind(root, "UNIT", false), 1, 1.0);
+    const WktNode *method = WktFind(root, "PROJECTION", false);
+    if (method == NULL || method->values.empty()) return false;
+
+    // Parameters are in the projected unit and the geographic angular unit
+    std::string name = WktNormalizeName(method->values[0]);
+    double lon0 = WktParameter(root, "central_meridian", WktParameter(root, "longitude_of_center", 0.0))*crs->angularUnit;
+    double lat0 = WktParameter(root, "latitude_of_origin", 0.0)*crs->angularUnit;
+    double k0 = WktParameter(root, "scale_factor", 1.0);
+    double falseEasting = WktParameter(root, "false_easting", 0.0)*crs->linearUnit;
+    double falseNorthing = WktParameter(root, "false_northing", 0.0)*crs->linearUnit;
+
+    if (name == "transverse_mercator" || name == "gauss_kruger")
+    {
+        crs->projection = TransverseMercatorProjection(crs->ellipsoid, lon0, lat0, k0, falseEasting, falseNorthing);
+    }
+    else if (name.find("auxiliary_sphere") != std::string::npos || name.find("pseudo_mercator") != std::string::npos)
+    {
+        crs->projection = WebMercatorProjection();
+    }
+    else if (name == "equirectangular" || name == "plate_carree" || name == "equidistant_cylindrical")
+    {
+        crs->projection = EquirectangularProjection(lon0, WktParameter(root, "standard_parallel_1", 0.0)*crs->angularUnit);
+        crs->projection.ellipsoid = crs->ellipsoid;
+    }
+    else return false;
+
+    return true;
+}
+
+// Coordinate system of a shapefile from the .prj beside it. Layers without one are WGS84
+// degrees; returns false (and WGS84) when the file exists but cannot be used.
+inline bool LoadPrj(const char *shapeFile, CoordinateSystem *crs)
+{
+    *crs = Wgs84CoordinateSystem();
+
+    std::string path(shapeFile);
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) path.erase(dot);
+    path += ".prj";
+
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) return true;
+
+    std::string wkt;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) wkt.append(buffer, n);
+    fclose(file);
+
+    if (ParseCoordinateSystem(wkt.c_str(), crs)) return true;
+    *crs = Wgs84CoordinateSystem();
+    return false;
+}
+
+//------------------------------------------------------------------------------------
+// Datum transformation
+//------------------------------------------------------------------------------------
+// Degrees on 'ellipsoid' (height 0) to earth-centred x, y, z in place
+inline void GeodeticToGeocentric(const Ellipsoid &ellipsoid, double *lon, double *lat, double *z, int count)
+{
+    double e2 = ellipsoid.f*(2.0 - ellipsoid.f);
+    for (int i = 0; i < count; i++)
+    {
+        double phi = lat[i]*PROJECTION_DEG2RAD, lambda = lon[i]*PROJECTION_DEG2RAD;
+        double sinPhi = sin(phi), cosPhi = cos(phi);
+        double n = ellipsoid.a/sqrt(1.0 - e2*sinPhi*sinPhi);
+        lon[i] = n*cosPhi*cos(lambda);
+        lat[i] = n*cosPhi*sin(lambda);
+        z[i] = n*(1.0 - e2)*sinPhi;
+    }
+}
+
+// Earth-centred x, y, z back to degrees on 'ellipsoid' in place, Bowring's closed form
+inline void GeocentricToGeodetic(const Ellipsoid &ellipsoid, double *x, double *y, const double *z, int count)
+{
+    double a = ellipsoid.a, b = a*(1.0 - ellipsoid.f);
+    double e2 = ellipsoid.f*(2.0 - ellipsoid.f), ep2 = e2/(1.0 - e2);
+    for (int i = 0; i < count; i++)
+    {
+        double p = sqrt(x[i]*x[i] + y[i]*y[i]);
+        double theta = atan2(z[i]*a, p*b);
+        double sinTheta = sin(theta), cosTheta = cos(theta);
+        double phi = atan2(z[i] + ep2*b*sinTheta*sinTheta*sinTheta, p - e2*a*cosTheta*cosTheta*cosTheta);
+        double lambda = atan2(y[i], x[i]);
+        x[i] = lambda*PROJECTION_RAD2DEG;
+        y[i] = phi*PROJECTION_RAD2DEG;
+    }
+}
+
+// Seven parameter Helmert, position vector convention as in TOWGS84, in place
+inline void HelmertTransform(const double *params, double *x, double *y, double *z, int count)
+{
+    double rx = params[3]*ARCSEC2RAD, ry = params[4]*ARCSEC2RAD, rz = params[5]*ARCSEC2RAD;
+    double s = 1.0 + params[6]*1e-6;
+    for (int i = 0; i < count; i++)
+    {
+        double px = x[i], py = y[i], pz = z[i];
+        x[i] = params[0] + s*(px - rz*py + ry*pz);
+        y[i] = params[1] + s*(rz*px + py - rx*pz);
+        z[i] = params[2] + s*(-ry*px + rx*py + pz);
+    }
+}
+
+inline CoordinateTransform MakeCoordinateTransform(const CoordinateSystem &source, const Projection &target)
+{
+    CoordinateTransform transform;
+    transform.source = source;
+    transform.target = target;
+    return transform;
+}
+
+inline bool CoordinateTransformIsIdentity(const CoordinateTransform &transform)
+{
+    const CoordinateSystem &source = transform.source;
+    return !source.projected && !source.datumShift && source.angularUnit == 1.0 &&
+           source.primeMeridian == 0.0 && transform.target.type == PROJECTION_GEOGRAPHIC;
+}
+
+// Source coordinates to target map units in place. 'z' is scratch space for 'count' doubles.
+inline void TransformPoints(const CoordinateTransform &transform, double *x, double *y, double *z, int count)
+{
+    const CoordinateSystem &source = transform.source;
+
+    if (source.projected)
+    {
+        if (source.linearUnit != 1.0)
+        {
+            for (int i = 0; i < count; i++) { x[i] *= source.linearUnit; y[i] *= source.linearUnit; }
+        }
+        ProjectInverse(source.projection, x, y, x, y, count);
+    }
+    else if (source.angularUnit != 1.0 || source.primeMeridian != 0.0)
+    {
+        for (int i = 0; i < count; i++) { x[i] = x[i]*source.angularUnit + source.primeMeridian; y[i] *= source.angularUnit; }
+    }
+
+    if (source.datumShift)
+    {
+        GeodeticToGeocentric(source.ellipsoid, x, y, z, count);
+        HelmertTransform(source.toWgs84, x, y, z, count);
+        GeocentricToGeodetic(WGS84Ellipsoid(), x, y, z, count);
+    }
+
+    ProjectForward(transform.target, x, y, x, y, count);
+}
+
+// Transform a SHPObject's vertices in place
+inline void TransformObject(const CoordinateTransform &transform, SHPObject *obj)
+{
+    if (obj == NULL || obj->nVertices == 0 || CoordinateTransformIsIdentity(transform)) return;
+    std::vector<double> z(obj->nVertices);
+    TransformPoints(transform, obj->padfX, obj->padfY, z.data(), obj->nVertices);
+}
+
+// Transform every vertex in place in PROJECTION_BATCH blocks on 'jobs' (serially without)
+// and refresh the bounds
+inline void TransformLayer(Layer *layer, const CoordinateTransform &transform, JobSystem *jobs = NULL)
+{
+    if (CoordinateTransformIsIdentity(transform)) return;
+
+    int count = (int)layer->x.size();
+    double *xs = layer->x.data(), *ys = layer->y.data();
+    auto body = [&transform, xs, ys](int first, int last) {
+        std::vector<double> z(last - first);
+        TransformPoints(transform, xs + first, ys + first, z.data(), last - first);
+    };
+    if (jobs != NULL) ParallelFor(jobs, count, PROJECTION_BATCH, body);
+    else body(0, count);
+
+    LayerUpdateBounds(layer);
+}
+
+// Approximate WGS84 degree extent of a box in source coordinates, from its corners and edge midpoints
+inline Bounds GeographicBounds(const CoordinateSystem &source, const Bounds &bounds)
+{
+    if (BoundsIsEmpty(bounds)) return bounds;
+
+    double mx = 0.5*(bounds.minX + bounds.maxX), my = 0.5*(bounds.minY + bounds.maxY);
+    double xs[8] = { bounds.minX, mx, bounds.maxX, bounds.maxX, bounds.maxX, mx, bounds.minX, bounds.minX };
+    double ys[8] = { bounds.minY, bounds.minY, bounds.minY, my, bounds.maxY, bounds.maxY, bounds.maxY, my };
+    double zs[8];
+    TransformPoints(MakeCoordinateTransform(source, GeographicProjection()), xs, ys, zs, 8);
+
+    Bounds geographic = EmptyBounds();
+    for (int i = 0; i < 8; i++) BoundsExtend(&geographic, xs[i], ys[i]);
+    return geographic;
+}
+
+#endif // VECTORMAP_PRJ_H
@@ -0,0 +1,336 @@
+#ifndef VECTORMAP_PROJECTION_H
+#define VECTORMAP_PROJECTION_H
+
+#include "Layer.h"
+#include "JobSystem.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define WGS84_A 6378137.0                       // Semi-major axis in metres
+#define WGS84_F (1.0/298.257223563)             // Flattening
+#define WEB_MERCATOR_MAX_LAT 85.051128779806    // Latitude where the square world ends
+#define UTM_SCALE 0.9996                        // Central meridian scale of every UTM zone
+#define UTM_FALSE_EASTING 500000.0
+#define UTM_FALSE_NORTHING_SOUTH 10000000.0
+#define PROJECTION_BATCH 4096                   // Vertices per job in ProjectLayer
+#define TM_ORDER 6                              // Terms of the Krueger series
+#define PROJECTION_PI 3.14159265358979323846    // raylib's PI and DEG2RAD are float
+#define PROJECTION_DEG2RAD (PROJECTION_PI/180.0)
+#define PROJECTION_RAD2DEG (180.0/PROJECTION_PI)
+
+//------------------------------------------------------------------------------------
+// Projection - geographic degrees to planar map units and back
+//
+// A Projection is set up once and then applied to whole coordinate arrays: the type is
+// dispatched per batch, not per vertex, so the inner loops are plain arithmetic over
+// contiguous doubles and a layer is projected at load time at close to memory speed.
+// Transverse Mercator (and UTM, and national grids, which are Transverse Mercator with
+// their own central meridian, scale and false origin) uses Krueger's series to sixth
+// order in n, good to well under a millimetre within a few thousand km of the meridian.
+// Web Mercator and equirectangular are spherical on the semi-major axis.
+//------------------------------------------------------------------------------------
+typedef enum {
+    PROJECTION_GEOGRAPHIC = 0,      // Identity, map units are degrees
+    PROJECTION_EQUIRECTANGULAR,
+    PROJECTION_WEB_MERCATOR,
+    PROJECTION_TRANSVERSE_MERCATOR
+} ProjectionType;
+
+typedef struct Ellipsoid {
+    double a;       // Semi-major axis
+    double f;       // Flattening, 0 for a sphere
+} Ellipsoid;
+
+typedef struct Projection {
+    int type;                   // ProjectionType
+    Ellipsoid ellipsoid;
+    double lon0;                // Central meridian, degrees
+    double lat0;                // Latitude of origin, degrees
+    double standardParallel;    // Equirectangular only, degrees
+    double k0;                  // Scale on the central meridian
+    double falseEasting;
+    double falseNorthing;
+
+    // Transverse Mercator series, filled by TransverseMercatorProjection
+    double e;                   // Eccentricity
+    double radius;              // k0 times the rectifying radius
+    double y0;                  // Northing of the latitude of origin
+    double alpha[TM_ORDER];     // Forward coefficients
+    double beta[TM_ORDER];      // Inverse coefficients
+} Projection;
+
+inline Ellipsoid WGS84Ellipsoid(void)
+{
+    Ellipsoid ellipsoid = { WGS84_A, WGS84_F };
+    return ellipsoid;
+}
+
+inline Projection GeographicProjection(void)
+{
+    Projection proj;
+    memset(&proj, 0, sizeof(proj));
+    proj.type = PROJECTION_GEOGRAPHIC;
+    proj.ellipsoid = WGS84Ellipsoid();
+    proj.k0 = 1.0;
+    return proj;
+}
+
+// Plate carree with true scale along 'standardParallel'
+inline Projection EquirectangularProjection(double lon0, double standardParallel)
+{
+    Projection proj = GeographicProjection();
+    proj.type = PROJECTION_EQUIRECTANGULAR;
+    proj.lon0 = lon0;
+    proj.standardParallel = standardParallel;
+    return proj;
+}
+
+// EPSG:3857, the spherical Mercator of web tiles
+inline Projection WebMercatorProjection(void)
+{
+    Projection proj = GeographicProjection();
+    proj.type = PROJECTION_WEB_MERCATOR;
+    return proj;
+}
+
+//------------------------------------------------------------------------------------
+// Batched transforms, one loop per projection type. Output may alias the input.
+//------------------------------------------------------------------------------------
+// Sum of coef[j]*sin(2(j + 1)(xi + i eta)) by the Chebyshev recurrence, four
+// transcendental calls instead of four per term
+inline void TransverseMercatorSeries(const double *coef, double xi, double eta, double *dxi, double *deta)
+{
+    double sx = sin(2.0*xi), cx = cos(2.0*xi), shy = sinh(2.0*eta), chy = cosh(2.0*eta);
+    double cr = cx*chy, ci = -sx*shy;           // cos(z)
+    double pr = 0.0, pi = 0.0;                  // sin((j - 1)z)
+    double sr = sx*chy, si = cx*shy;            // sin(jz)
+    double sumR = 0.0, sumI = 0.0;
+    for (int j = 0; j < TM_ORDER; j++)
+    {
+        sumR += coef[j]*sr;
+        sumI += coef[j]*si;
+        double nr = 2.0*(cr*sr - ci*si) - pr, ni = 2.0*(cr*si + ci*sr) - pi;
+        pr = sr; pi = si;
+        sr = nr; si = ni;
+    }
+    *dxi = sumR;
+    *deta = sumI;
+}
+
+inline void ProjectTransverseMercator(const Projection &proj, const double *lon, const double *lat, double *x, double *y, int count)
+{
+    double e = proj.e;
+    for (int i = 0; i < count; i++)
+    {
+        double lambda = (lon[i] - proj.lon0)*PROJECTION_DEG2RAD;
+        double tau = tan(lat[i]*PROJECTION_DEG2RAD);
+        double sigma = sinh(e*atanh(e*tau/sqrt(1.0 + tau*tau)));
+        double tauP = tau*sqrt(1.0 + sigma*sigma) - sigma*sqrt(1.0 + tau*tau);
+        double xiP = atan2(tauP, cos(lambda));
+        double etaP = asinh(sin(lambda)/sqrt(tauP*tauP + cos(lambda)*cos(lambda)));
+
+        double dxi, deta;
+        TransverseMercatorSeries(proj.alpha, xiP, etaP, &dxi, &deta);
+        double xi = xiP + dxi, eta = etaP + deta;
+
+        x[i] = proj.falseEasting + proj.radius*eta;
+        y[i] = proj.falseNorthing + proj.radius*xi - proj.y0;
+    }
+}
+
+inline void UnprojectTransverseMercator(const Projection &proj, const double *x, const double *y, double *lon, double *lat, int count)
+{
+    double e = proj.e, e2 = e*e;
+    for (int i = 0; i < count; i++)
+    {
+        double xi = (y[i] - proj.falseNorthing + proj.y0)/proj.radius;
+        double eta = (x[i] - proj.falseEasting)/proj.radius;
+
+        double dxi, deta;
+        TransverseMercatorSeries(proj.beta, xi, eta, &dxi, &deta);
+        double xiP = xi - dxi, etaP = eta - deta;
+
+        double sinhEta = sinh(etaP), cosXi = cos(xiP);
+        double tauP = sin(xiP)/sqrt(sinhEta*sinhEta + cosXi*cosXi);
+
+        // Newton on tau' = f(tau), converges in two or three steps
+        double tau = tauP;
+        for (int iter = 0; iter < 8; iter++)
+        {
+            double sigma = sinh(e*atanh(e*tau/sqrt(1.0 + tau*tau)));
+            double tauI = tau*sqrt(1.0 + sigma*sigma) - sigma*sqrt(1.0 + tau*tau);
+            double delta = (tauP - tauI)/sqrt(1.0 + tauI*tauI)*(1.0 + (1.0 - e2)*tau*tau)/((1.0 - e2)*sqrt(1.0 + tau*tau));
+            tau += delta;
+            if (fabs(delta) < 1e-12) break;
+        }
+
+        lat[i] = atan(tau)*PROJECTION_RAD2DEG;
+        lon[i] = proj.lon0 + atan2(sinhEta, cosXi)*PROJECTION_RAD2DEG;
+    }
+}
+
+inline Projection TransverseMercatorProjection(Ellipsoid ellipsoid, double lon0, double lat0, double k0, double falseEasting, double falseNorthing)
+{
+    Projection proj = GeographicProjection();
+    proj.type = PROJECTION_TRANSVERSE_MERCATOR;
+    proj.ellipsoid = ellipsoid;
+    proj.lon0 = lon0;
+    proj.lat0 = lat0;
+    proj.k0 = k0;
+    proj.falseEasting = falseEasting;
+    proj.falseNorthing = falseNorthing;
+
+    double f = ellipsoid.f;
+    double n = f/(2.0 - f), n2 = n*n, n3 = n2*n, n4 = n3*n, n5 = n4*n, n6 = n5*n;
+    proj.e = sqrt(f*(2.0 - f));
+    proj.radius = k0*ellipsoid.a/(1.0 + n)*(1.0 + n2/4.0 + n4/64.0 + n6/256.0);
+
+    proj.alpha[0] = n/2.0 - 2.0*n2/3.0 + 5.0*n3/16.0 + 41.0*n4/180.0 - 127.0*n5/288.0 + 7891.0*n6/37800.0;
+    proj.alpha[1] = 13.0*n2/48.0 - 3.0*n3/5.0 + 557.0*n4/1440.0 + 281.0*n5/630.0 - 1983433.0*n6/1935360.0;
+    proj.alpha[2] = 61.0*n3/240.0 - 103.0*n4/140.0 + 15061.0*n5/26880.0 + 167603.0*n6/181440.0;
+    proj.alpha[3] = 49561.0*n4/161280.0 - 179.0*n5/168.0 + 6601661.0*n6/7257600.0;
+    proj.alpha[4] = 34729.0*n5/80640.0 - 3418889.0*n6/1995840.0;
+    proj.alpha[5] = 212378941.0*n6/319334400.0;
+
+    proj.beta[0] = n/2.0 - 2.0*n2/3.0 + 37.0*n3/96.0 - n4/360.0 - 81.0*n5/512.0 + 96199.0*n6/604800.0;
+    proj.beta[1] = n2/48.0 + n3/15.0 - 437.0*n4/1440.0 + 46.0*n5/105.0 - 1118711.0*n6/3870720.0;
+    proj.beta[2] = 17.0*n3/480.0 - 37.0*n4/840.0 - 209.0*n5/4480.0 + 5569.0*n6/90720.0;
+    proj.beta[3] = 4397.0*n4/161280.0 - 11.0*n5/504.0 - 830251.0*n6/7257600.0;
+    proj.beta[4] = 4583.0*n5/161280.0 - 108847.0*n6/3991680.0;
+    proj.beta[5] = 20648693.0*n6/638668800.0;
+
+    // Northing of the origin latitude on the central meridian, from the series itself
+    double x, y;
+    proj.y0 = 0.0;
+    ProjectTransverseMercator(proj, &lon0, &lat0, &x, &y, 1);
+    proj.y0 = y - falseNorthing;
+
+    return proj;
+}
+
+inline int UtmZone(double lon)
+{
+    int zone = (int)floor((lon + 180.0)/6.0) + 1;
+    return (zone < 1) ? 1 : (zone > 60) ? 60 : zone;
+}
+
+inline Projection UtmProjection(int zone, bool south)
+{
+    return TransverseMercatorProjection(WGS84Ellipsoid(), zone*6.0 - 183.0, 0.0, UTM_SCALE,
+                                        UTM_FALSE_EASTING, south ? UTM_FALSE_NORTHING_SOUTH : 0.0);
+}
+
+// Geographic degrees to map units
+inline void ProjectForward(const Projection &proj, const double *lon, const double *lat, double *x, double *y, int count)
+{
+    double r = proj.ellipsoid.a;
+    switch (proj.type)
+    {
+        case PROJECTION_EQUIRECTANGULAR:
+        {
+            double sx = r*PROJECTION_DEG2RAD*cos(proj.standardParallel*PROJECTION_DEG2RAD), sy = r*PROJECTION_DEG2RAD;
+            for (int i = 0; i < count; i++)
+            {
+                double px = (lon[i] - proj.lon0)*sx, py = lat[i]*sy;
+                x[i] = px;
+                y[i] = py;
+            }
+        } break;
+        case PROJECTION_WEB_MERCATOR:
+        {
+            for (int i = 0; i < count; i++)
+            {
+                double phi = fmax(-WEB_MERCATOR_MAX_LAT, fmin(WEB_MERCATOR_MAX_LAT, lat[i]))*PROJECTION_DEG2RAD;
+                double px = r*lon[i]*PROJECTION_DEG2RAD, py = r*log(tan(0.25*PROJECTION_PI + 0.5*phi));
+                x[i] = px;
+                y[i] = py;
+            }
+        } break;
+        case PROJECTION_TRANSVERSE_MERCATOR: ProjectTransverseMercator(proj, lon, lat, x, y, count); break;
+        default:
+        {
+            if (x != lon) memmove(x, lon, count*sizeof(double));
+            if (y != lat) memmove(y, lat, count*sizeof(double));
+        } break;
+    }
+}
+
+// Map units back to geographic degrees
+inline void ProjectInverse(const Projection &proj, const double *x, const double *y, double *lon, double *lat, int count)
+{
+    double r = proj.ellipsoid.a;
+    switch (proj.type)
+    {
+        case PROJECTION_EQUIRECTANGULAR:
+        {
+            double sx = 1.0/(r*PROJECTION_DEG2RAD*cos(proj.standardParallel*PROJECTION_DEG2RAD)), sy = 1.0/(r*PROJECTION_DEG2RAD);
+            for (int i = 0; i < count; i++)
+            {
+                double px = proj.lon0 + x[i]*sx, py = y[i]*sy;
+                lon[i] = px;
+                lat[i] = py;
+            }
+        } break;
+        case PROJECTION_WEB_MERCATOR:
+        {
+            for (int i = 0; i < count; i++)
+            {
+                double px = x[i]/r*PROJECTION_RAD2DEG, py = (2.0*atan(exp(y[i]/r)) - 0.5*PROJECTION_PI)*PROJECTION_RAD2DEG;
+                lon[i] = px;
+                lat[i] = py;
+            }
+        } break;
+        case PROJECTION_TRANSVERSE_MERCATOR: UnprojectTransverseMercator(proj, x, y, lon, lat, count); break;
+        default:
+        {
+            if (lon != x) memmove(lon, x, count*sizeof(double));
+            if (lat != y) memmove(lat, y, count*sizeof(double));
+        } break;
+    }
+}
+
+// Recompute the feature and layer boxes after the coordinates changed
+inline void LayerUpdateBounds(Layer *layer)
+{
+    layer->bounds = EmptyBounds();
+    for (int f = 0; f < layer->featureCount; f++)
+    {
+        Bounds b = EmptyBounds();
+        int first = layer->partStart[layer->featurePart[f]], last = layer->partStart[layer->featurePart[f + 1]];
+        for (int v = first; v < last; v++) BoundsExtend(&b, layer->x[v], layer->y[v]);
+        layer->featureBounds[f] = b;
+        if (!BoundsIsEmpty(b)) BoundsMerge(&layer->bounds, b);
+    }
+}
+
+// Project every vertex in place, in PROJECTION_BATCH blocks on 'jobs' when given
+inline void ProjectLayer(Layer *layer, const Projection &proj, JobSystem *jobs = NULL)
+{
+    if (proj.type == PROJECTION_GEOGRAPHIC) return;
+
+    int count = (int)layer->x.size();
+    double *xs = layer->x.data(), *ys = layer->y.data();
+    auto body = [&proj, xs, ys](int first, int last) { ProjectForward(proj, xs + first, ys + first, xs + first, ys + first, last - first); };
+    if (jobs != NULL) ParallelFor(jobs, count, PROJECTION_BATCH, body);
+    else body(0, count);
+
+    LayerUpdateBounds(layer);
+}
+
+// Projection from a command line name: geographic, equirectangular, mercator, utm or tm.
+// Equirectangular, utm and tm are centred on 'extent' (degrees), tm is a local grid with
+// unit scale on the meridian through the centre. Unknown names give equirectangular.
+inline Projection ProjectionFromName(const char *name, const Bounds &extent)
+{
+    double lon = BoundsIsEmpty(extent) ? 0.0 : 0.5*(extent.minX + extent.maxX);
+    double lat = BoundsIsEmpty(extent) ? 0.0 : 0.5*(extent.minY + extent.maxY);
+
+    if (name != NULL && strcmp(name, "geographic") == 0) return GeographicProjection();
+    if (name != NULL && strcmp(name, "mercator") == 0) return WebMercatorProjection();
+    if (name != NULL && strcmp(name, "utm") == 0) return UtmProjection(UtmZone(lon), lat < 0.0);
+    if (name != NULL && strcmp(name, "tm") == 0) return TransverseMercatorProjection(WGS84Ellipsoid(), lon, 0.0, 1.0, UTM_FALSE_EASTING, 0.0);
+    return EquirectangularProjection(lon, lat);
+}
+
+#endif // VECTORMAP_PROJECTION_H
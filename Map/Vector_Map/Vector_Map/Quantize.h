@@ -0,0 +1,180 @@
+#ifndef VECTORMAP_QUANTIZE_H
+#define VECTORMAP_QUANTIZE_H
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "raymath.h"
+#include "Layer.h"
+#include "LayerMesh.h"
+#include "RenderFrame.h"
+#include <vector>
+#include <math.h>
+#include <float.h>
+
+#define QUANTIZE_LEVELS 65535.0         // Largest 16-bit coordinate
+#define QUANTIZE_GL_UNSIGNED_SHORT 0x1403   // GL_UNSIGNED_SHORT, rlgl has no alias for it
+
+//------------------------------------------------------------------------------------
+// Quantize - 16-bit tile-local vertex positions
+//
+// A tile stores its vertices as two unsigned shorts on a 65536 step grid spanning the
+// tile extent; the extent (scale) travels as a uniform and the tile origin, relative to
+// the render frame, in the model matrix, so the vertex shader decodes position =
+// q/65535*extent and the rest of the pipeline is unchanged. A vertex takes 4 bytes on
+// the GPU instead of 12 (float xyz). Rounding moves a vertex by at most half a step per
+// axis, see QuantizationErrorBound.
+//------------------------------------------------------------------------------------
+typedef struct QuantizedChunkData {
+    std::vector<unsigned short> positions;  // x, y per vertex
+    std::vector<unsigned short> indices;
+} QuantizedChunkData;
+
+typedef struct QuantizedMesh {
+    unsigned int vaoId;
+    unsigned int vboId[2];      // Positions, indices
+    int vertexCount;
+    int indexCount;
+} QuantizedMesh;
+
+typedef struct QuantizedShader {
+    Shader shader;
+    int extentLoc;
+} QuantizedShader;
+
+static const char *QUANTIZED_MESH_VS =
+    "#version 330\n"
+    "in vec2 vertexPosition;\n"        // Normalized unsigned shorts, 0..1
+    "uniform mat4 mvp;\n"
+    "uniform vec2 extent;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = mvp*vec4(vertexPosition*extent, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *QUANTIZED_MESH_FS =
+    "#version 330\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main()\n"
+    "{\n"
+    "    finalColor = colDiffuse;\n"
+    "}\n";
+
+// Tile extent used for quantizing, never 0 so points and flat tiles still decode
+inline double QuantizeExtent(double size)
+{
+    return (size > 0.0) ? size : 1.0;
+}
+
+inline unsigned short QuantizeValue(double v, double origin, double extent)
+{
+    double q = floor((v - origin)/extent*QUANTIZE_LEVELS + 0.5);
+    return (unsigned short)((q < 0.0) ? 0.0 : (q > QUANTIZE_LEVELS) ? QUANTIZE_LEVELS : q);
+}
+
+inline double DequantizeValue(unsigned short q, double origin, double extent)
+{
+    return origin + q*extent/QUANTIZE_LEVELS;
+}
+
+// Largest distance between a vertex inside 'bounds' and its decoded position: half a
+// step on each axis, plus the float rounding of an origin-relative input
+inline double QuantizationErrorBound(const Bounds &bounds)
+{
+    double ex = QuantizeExtent(bounds.maxX - bounds.minX), ey = QuantizeExtent(bounds.maxY - bounds.minY);
+    double hx = 0.5*ex/QUANTIZE_LEVELS + ex*FLT_EPSILON;
+    double hy = 0.5*ey/QUANTIZE_LEVELS + ey*FLT_EPSILON;
+    return sqrt(hx*hx + hy*hy);
+}
+
+// Re-encode a float chunk stored relative to bounds.minX/minY on the grid of 'bounds'
+inline QuantizedChunkData QuantizeChunk(const MeshChunkData &chunk, const Bounds &bounds)
+{
+    double ex = QuantizeExtent(bounds.maxX - bounds.minX), ey = QuantizeExtent(bounds.maxY - bounds.minY);
+
+    QuantizedChunkData quantized;
+    quantized.positions.reserve(2*chunk.vertices.size()/3);
+    for (size_t v = 0; v + 2 < chunk.vertices.size(); v += 3)
+    {
+        quantized.positions.push_back(QuantizeValue(chunk.vertices[v], 0.0, ex));
+        quantized.positions.push_back(QuantizeValue(chunk.vertices[v + 1], 0.0, ey));
+    }
+    quantized.indices = chunk.indices;
+
+    return quantized;
+}
+
+inline size_t QuantizedChunkBytes(const QuantizedChunkData &chunk)
+{
+    return (chunk.positions.size() + chunk.indices.size())*sizeof(unsigned short);
+}
+
+// Needs an open window
+inline QuantizedShader LoadQuantizedShader(void)
+{
+    QuantizedShader quantized;
+    quantized.shader = LoadShaderFromMemory(QUANTIZED_MESH_VS, QUANTIZED_MESH_FS);
+    quantized.extentLoc = GetShaderLocation(quantized.shader, "extent");
+    return quantized;
+}
+
+inline QuantizedMesh UploadQuantizedChunk(const QuantizedChunkData &chunk)
+{
+    QuantizedMesh mesh = { 0 };
+    mesh.vertexCount = (int)(chunk.positions.size()/2);
+    mesh.indexCount = (int)chunk.indices.size();
+
+    mesh.vaoId = rlLoadVertexArray();
+    rlEnableVertexArray(mesh.vaoId);
+    mesh.vboId[0] = rlLoadVertexBuffer(chunk.positions.data(), (int)(chunk.positions.size()*sizeof(unsigned short)), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, QUANTIZE_GL_UNSIGNED_SHORT, true, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+    mesh.vboId[1] = rlLoadVertexBufferElement(chunk.indices.data(), (int)(chunk.indices.size()*sizeof(unsigned short)), false);
+    rlDisableVertexArray();
+
+    return mesh;
+}
+
+// Draw chunks quantized over 'bounds', the tile corner is placed relative to the frame origin in double
+inline void DrawQuantizedChunks(const std::vector<QuantizedMesh> &chunks, const QuantizedShader &quantized, const Bounds &bounds, const RenderFrame &frame, Color color)
+{
+    if (chunks.empty()) return;
+
+    // Everything batched so far goes first, the chunks are drawn right away
+    rlDrawRenderBatchActive();
+
+    Matrix model = MatrixMultiply(RenderFrameMatrix(frame, bounds.minX, bounds.minY), rlGetMatrixTransform());
+    Matrix mvp = MatrixMultiply(MatrixMultiply(model, rlGetMatrixModelview()), rlGetMatrixProjection());
+    float extent[2] = { (float)QuantizeExtent(bounds.maxX - bounds.minX), (float)QuantizeExtent(bounds.maxY - bounds.minY) };
+    float tint[4] = { color.r/255.0f, color.g/255.0f, color.b/255.0f, color.a/255.0f };
+
+    rlEnableShader(quantized.shader.id);
+    rlSetUniformMatrix(quantized.shader.locs[SHADER_LOC_MATRIX_MVP], mvp);
+    rlSetUniform(quantized.extentLoc, extent, RL_SHADER_UNIFORM_VEC2, 1);
+    rlSetUniform(quantized.shader.locs[SHADER_LOC_COLOR_DIFFUSE], tint, RL_SHADER_UNIFORM_VEC4, 1);
+
+    // The world to screen mapping may mirror y, draw both windings
+    rlDisableBackfaceCulling();
+    for (int i = 0; i < (int)chunks.size(); i++)
+    {
+        rlEnableVertexArray(chunks[i].vaoId);
+        rlDrawVertexArrayElements(0, chunks[i].indexCount, 0);
+    }
+    rlDisableVertexArray();
+    rlEnableBackfaceCulling();
+    rlDisableShader();
+}
+
+inline void UnloadQuantizedMesh(QuantizedMesh mesh)
+{
+    rlUnloadVertexArray(mesh.vaoId);
+    rlUnloadVertexBuffer(mesh.vboId[0]);
+    rlUnloadVertexBuffer(mesh.vboId[1]);
+}
+
+inline void UnloadQuantizedShader(QuantizedShader quantized)
+{
+    UnloadShader(quantized.shader);
+}
+
+#endif // VECTORMAP_QUANTIZE_H
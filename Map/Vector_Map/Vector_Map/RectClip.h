@@ -0,0 +1,307 @@
+#ifndef VECTORMAP_RECT_CLIP_H
+#define VECTORMAP_RECT_CLIP_H
+
+#include "Layer.h"
+#include <vector>
+
+#define RECT_OUT_LEFT 1         // Outcode bits, Cohen-Sutherland order
+#define RECT_OUT_RIGHT 2
+#define RECT_OUT_BOTTOM 4
+#define RECT_OUT_TOP 8
+
+//------------------------------------------------------------------------------------
+// RectClip - clipping features to an axis aligned rectangle (tile cells)
+//
+// Outcodes for a whole part are computed first in one branch-free loop the compiler
+// vectorizes; their AND and OR settle most parts without clipping: OR == 0 lies inside
+// and is copied, AND != 0 lies beyond one side and is dropped. Rings that straddle the
+// rectangle run Sutherland-Hodgman, one pass per side some vertex is outside of, so a
+// ring crossing only the right edge costs one pass. Polygon output may run along the
+// rectangle border where a concave ring leaves and comes back; those zero-width edges
+// triangulate to nothing. Lines use Liang-Barsky per segment and split into a new part
+// wherever they leave the rectangle. Points are kept when inside. Vertices created on
+// the border take the border coordinate exactly, so neighbouring cells agree.
+//------------------------------------------------------------------------------------
+typedef struct RectClipper {
+    Bounds rect;
+    std::vector<int> codes;             // Per vertex outcodes of the current part
+    std::vector<double> x[2];           // Sutherland-Hodgman ping-pong buffers
+    std::vector<double> y[2];
+    std::vector<double> ringX;          // Last clipped ring
+    std::vector<double> ringY;
+} RectClipper;
+
+inline RectClipper CreateRectClipper(const Bounds &rect)
+{
+    RectClipper clipper;
+    clipper.rect = rect;
+    return clipper;
+}
+
+// Outcodes of count vertices, returns the OR and writes the AND of all of them
+inline int RectOutcodes(RectClipper *clipper, const double *xs, const double *ys, int count, int *andCode)
+{
+    const Bounds &r = clipper->rect;
+    clipper->codes.resize(count);
+    int *codes = clipper->codes.data();
+    int orCode = 0, all = RECT_OUT_LEFT | RECT_OUT_RIGHT | RECT_OUT_BOTTOM | RECT_OUT_TOP;
+    for (int i = 0; i < count; i++)
+    {
+        int code = (xs[i] < r.minX) | ((xs[i] > r.maxX) << 1) | ((ys[i] < r.minY) << 2) | ((ys[i] > r.maxY) << 3);
+        codes[i] = code;
+        orCode |= code;
+        all &= code;
+    }
+    *andCode = all;
+    return orCode;
+}
+
+inline bool RectInsideSide(int side, double x, double y, const Bounds &r)
+{
+    switch (side)
+    {
+        case RECT_OUT_LEFT: return x >= r.minX;
+        case RECT_OUT_RIGHT: return x <= r.maxX;
+        case RECT_OUT_BOTTOM: return y >= r.minY;
+        default: return y <= r.maxY;
+    }
+}
+
+// Point where a -> b crosses the line of one side, the border coordinate is exact
+inline void RectSideIntersection(int side, double ax, double ay, double bx, double by, const Bounds &r, double *x, double *y)
+{
+    if (side == RECT_OUT_LEFT || side == RECT_OUT_RIGHT)
+    {
+        double edge = (side == RECT_OUT_LEFT) ? r.minX : r.maxX;
+        *x = edge;
+        *y = ay + (edge - ax)*(by - ay)/(bx - ax);
+    }
+    else
+    {
+        double edge = (side == RECT_OUT_BOTTOM) ? r.minY : r.maxY;
+        *x = ax + (edge - ay)*(bx - ax)/(by - ay);
+        *y = edge;
+    }
+}
+
+// Clip an open ring (the closing vertex may be repeated) into outX/outY as an open ring.
+// Returns false when less than a triangle is left.
+inline bool ClipRingToRect(RectClipper *clipper, const double *xs, const double *ys, int count, std::vector<double> *outX, std::vector<double> *outY)
+{
+    outX->clear();
+    outY->clear();
+    if (count > 1 && xs[0] == xs[count - 1] && ys[0] == ys[count - 1]) count--;
+    if (count < 3) return false;
+
+    int andCode = 0;
+    int orCode = RectOutcodes(clipper, xs, ys, count, &andCode);
+    if (andCode != 0) return false;
+    if (orCode == 0)
+    {
+        outX->assign(xs, xs + count);
+        outY->assign(ys, ys + count);
+        return true;
+    }
+
+    const Bounds &r = clipper->rect;
+    int current = 0;
+    clipper->x[0].assign(xs, xs + count);
+    clipper->y[0].assign(ys, ys + count);
+    for (int side = RECT_OUT_LEFT; side <= RECT_OUT_TOP; side <<= 1)
+    {
+        if ((orCode & side) == 0) continue;
+
+        const std::vector<double> &inX = clipper->x[current], &inY = clipper->y[current];
+        std::vector<double> &nextX = clipper->x[1 - current], &nextY = clipper->y[1 - current];
+        nextX.clear();
+        nextY.clear();
+
+        int n = (int)inX.size();
+        if (n == 0) break;
+        double px = inX[n - 1], py = inY[n - 1];
+        bool previousInside = RectInsideSide(side, px, py, r);
+        for (int i = 0; i < n; i++)
+        {
+            double cx = inX[i], cy = inY[i];
+            bool inside = RectInsideSide(side, cx, cy, r);
+            if (inside != previousInside)
+            {
+                double ix, iy;
+                RectSideIntersection(side, px, py, cx, cy, r, &ix, &iy);
+                nextX.push_back(ix);
+                nextY.push_back(iy);
+            }
+            if (inside)
+            {
+                nextX.push_back(cx);
+                nextY.push_back(cy);
+            }
+            px = cx;
+            py = cy;
+            previousInside = inside;
+        }
+        current = 1 - current;
+    }
+
+    outX->swap(clipper->x[current]);
+    outY->swap(clipper->y[current]);
+    return outX->size() >= 3;
+}
+
+// Liang-Barsky: the visible parameter range [*t0, *t1] of a -> b, false when none
+inline bool ClipSegmentToRect(const Bounds &r, double ax, double ay, double bx, double by, double *t0, double *t1)
+{
+    double dx = bx - ax, dy = by - ay;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { ax - r.minX, r.maxX - ax, ay - r.minY, r.maxY - ay };
+    double lo = 0.0, hi = 1.0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (p[i] == 0.0)
+        {
+            if (q[i] < 0.0) return false;
+            continue;
+        }
+        double t = q[i]/p[i];
+        if (p[i] < 0.0) { if (t > lo) lo = t; }
+        else if (t < hi) hi = t;
+        if (lo > hi) return false;
+    }
+
+    *t0 = lo;
+    *t1 = hi;
+    return true;
+}
+
+// Point at t along a -> b, snapped onto the border it was clipped at
+inline void RectClipPoint(const Bounds &r, double ax, double ay, double bx, double by, double t, double *x, double *y)
+{
+    *x = ax + t*(bx - ax);
+    *y = ay + t*(by - ay);
+    *x = (*x < r.minX) ? r.minX : (*x > r.maxX) ? r.maxX : *x;
+    *y = (*y < r.minY) ? r.minY : (*y > r.maxY) ? r.maxY : *y;
+}
+
+// Close the part being written to 'out', dropping it when it has fewer than 'minimum' vertices
+inline void RectClipEndPart(Layer *out, int start, int minimum, Bounds *b)
+{
+    int count = (int)out->x.size() - start;
+    if (count < minimum)
+    {
+        out->x.resize(start);
+        out->y.resize(start);
+        return;
+    }
+    for (int v = start; v < start + count; v++) BoundsExtend(b, out->x[v], out->y[v]);
+    out->partStart.push_back((int)out->x.size());
+}
+
+// Append feature 'feature' of 'layer' clipped to the clipper rectangle as the next feature
+// of 'out' (possibly with no parts). Rings are written closed.
+inline void ClipFeatureToRect(RectClipper *clipper, const Layer &layer, int feature, Layer *out)
+{
+    if (out->featurePart.empty()) out->featurePart.push_back(0);
+    if (out->partStart.empty()) out->partStart.push_back(0);
+
+    const Bounds &r = clipper->rect;
+    const Bounds &fb = layer.featureBounds[feature];
+    bool polygon = IsPolygonType(layer.shapeType), line = IsLineType(layer.shapeType);
+    bool inside = !BoundsIsEmpty(fb) && BoundsContainsBounds(r, fb);
+    bool outside = BoundsIsEmpty(fb) || !BoundsIntersect(r, fb);
+    Bounds b = EmptyBounds();
+
+    for (int p = layer.featurePart[feature]; !outside && p < layer.featurePart[feature + 1]; p++)
+    {
+        int first = layer.partStart[p], count = layer.partStart[p + 1] - first;
+        const double *xs = layer.x.data() + first, *ys = layer.y.data() + first;
+        int start = (int)out->x.size();
+
+        if (inside || (!polygon && !line))
+        {
+            for (int v = 0; v < count; v++)
+            {
+                if (!inside && !BoundsContainsPoint(r, xs[v], ys[v])) continue;
+                out->x.push_back(xs[v]);
+                out->y.push_back(ys[v]);
+            }
+            RectClipEndPart(out, start, 1, &b);
+        }
+        else if (polygon)
+        {
+            std::vector<double> &ringX = clipper->ringX, &ringY = clipper->ringY;
+            if (!ClipRingToRect(clipper, xs, ys, count, &ringX, &ringY)) continue;
+            out->x.insert(out->x.end(), ringX.begin(), ringX.end());
+            out->y.insert(out->y.end(), ringY.begin(), ringY.end());
+            out->x.push_back(ringX[0]);
+            out->y.push_back(ringY[0]);
+            RectClipEndPart(out, start, 4, &b);
+        }
+        else
+        {
+            int andCode = 0;
+            int orCode = RectOutcodes(clipper, xs, ys, count, &andCode);
+            if (andCode != 0) continue;
+            if (orCode == 0)
+            {
+                out->x.insert(out->x.end(), xs, xs + count);
+                out->y.insert(out->y.end(), ys, ys + count);
+                RectClipEndPart(out, start, 2, &b);
+                continue;
+            }
+
+            // Walk the segments, a part ends where a segment leaves the rectangle
+            const int *codes = clipper->codes.data();
+            for (int v = 0; v + 1 < count; v++)
+            {
+                double t0, t1;
+                if ((codes[v] & codes[v + 1]) != 0 || !ClipSegmentToRect(r, xs[v], ys[v], xs[v + 1], ys[v + 1], &t0, &t1)) continue;
+                if (t0 == t1 && codes[v] != 0 && codes[v + 1] != 0) continue;   // Grazes a corner
+
+                double x, y;
+                if ((int)out->x.size() == start)
+                {
+                    if (codes[v] == 0) { x = xs[v]; y = ys[v]; }
+                    else RectClipPoint(r, xs[v], ys[v], xs[v + 1], ys[v + 1], t0, &x, &y);
+                    out->x.push_back(x);
+                    out->y.push_back(y);
+                }
+                if (codes[v + 1] == 0)
+                {
+                    out->x.push_back(xs[v + 1]);
+                    out->y.push_back(ys[v + 1]);
+                    continue;
+                }
+                RectClipPoint(r, xs[v], ys[v], xs[v + 1], ys[v + 1], t1, &x, &y);
+                out->x.push_back(x);
+                out->y.push_back(y);
+                RectClipEndPart(out, start, 2, &b);
+                start = (int)out->x.size();
+            }
+            RectClipEndPart(out, start, 2, &b);
+        }
+    }
+
+    out->featurePart.push_back((int)out->partStart.size() - 1);
+    out->featureBounds.push_back(b);
+    if (!BoundsIsEmpty(b)) BoundsMerge(&out->bounds, b);
+    out->featureCount++;
+}
+
+// Every feature clipped to 'rect', feature numbering and columns are kept
+inline Layer ClipLayerToRect(const Layer &layer, const Bounds &rect)
+{
+    Layer out;
+    out.shapeType = layer.shapeType;
+    out.featureCount = 0;
+    out.bounds = EmptyBounds();
+    out.columns = layer.columns;
+    out.featureBounds.reserve(layer.featureCount);
+    out.featurePart.reserve(layer.featureCount + 1);
+
+    RectClipper clipper = CreateRectClipper(rect);
+    for (int f = 0; f < layer.featureCount; f++) ClipFeatureToRect(&clipper, layer, f, &out);
+    return out;
+}
+
+#endif // VECTORMAP_RECT_CLIP_H
@@ -0,0 +1,44 @@
+#ifndef VECTORMAP_RENDER_FRAME_H
+#define VECTORMAP_RENDER_FRAME_H
+
+#include "raylib.h"
+#include "raymath.h"
+
+//------------------------------------------------------------------------------------
+// RenderFrame - relative-to-centre drawing of double precision map data
+//
+// Projected coordinates are large (millions of metres) and a float keeps about seven
+// digits, so a vertex stored or transformed as an absolute float jitters by metres at
+// deep zoom. Geometry is instead stored as small floats relative to a per-tile or
+// per-chunk origin kept in double, and the frame holds the camera's origin in double:
+// origin - frame origin is taken in double before anything becomes a float, so every
+// float that reaches the GPU is a small offset near the view. The matching Camera2D is
+// the frame's camera with its target moved to 0, see RelativeCamera.
+//------------------------------------------------------------------------------------
+typedef struct RenderFrame {
+    double originX;     // Source point drawn at the camera target
+    double originY;
+    double scaleX;      // Drawing units per source unit, negative to mirror
+    double scaleY;
+} RenderFrame;
+
+// The same view with the target at the origin of the drawing space
+inline Camera2D RelativeCamera(Camera2D camera)
+{
+    camera.target = Vector2{ 0.0f, 0.0f };
+    return camera;
+}
+
+inline Vector2 RenderFramePoint(const RenderFrame &frame, double x, double y)
+{
+    return Vector2{ (float)((x - frame.originX)*frame.scaleX), (float)((y - frame.originY)*frame.scaleY) };
+}
+
+// Model matrix for vertices stored relative to (x, y) in source units
+inline Matrix RenderFrameMatrix(const RenderFrame &frame, double x, double y)
+{
+    Vector2 offset = RenderFramePoint(frame, x, y);
+    return MatrixMultiply(MatrixScale((float)frame.scaleX, (float)frame.scaleY, 1.0f), MatrixTranslate(offset.x, offset.y, 0.0f));
+}
+
+#endif // VECTORMAP_RENDER_FRAME_H
@@ -0,0 +1,308 @@
+#ifndef VECTORMAP_SELF_TEST_H
+#define VECTORMAP_SELF_TEST_H
+
+#include "Layer.h"
+#include "Geometry.h"
+#include "SpatialIndex.h"
+#include "Projection.h"
+#include "Quantize.h"
+#include "PointInPolygon.h"
+#include "JobSystem.h"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+
+#define SELFTEST_FEATURES 20000         // Random polygons in the test layer by default
+#define SELFTEST_QUERIES 10000          // Timed query points
+#define SELFTEST_CHECKS 200             // Of those, checked against a scan of every feature
+#define SELFTEST_PICK_RADIUS 2.0        // Nearest search radius, in map units of the test layer
+#define SELFTEST_NEAREST_K 5            // Neighbours compared per nearest query
+#define SELFTEST_TILES 256              // Random tile boxes quantized and decoded
+#define SELFTEST_JOIN_POINTS 100001     // Random points joined, odd so the scalar tail runs
+#define SELFTEST_JOIN_FEATURES 500      // Polygons whose vertices and slab boundaries are joined too
+#define SELFTEST_SEED 20240611          // Fixed so a failure reproduces
+
+//------------------------------------------------------------------------------------
+// SelfTest - the index and geometry kernels checked against brute force
+//
+// Random layers are built through LayerAppendObject like a loaded shapefile, the fast
+// path is timed over a set of random queries and its answers are compared with a scan
+// of every feature. Every check prints one line and returns its failure count, so the
+// --selftest tool mode can exit non-zero on any mismatch.
+//------------------------------------------------------------------------------------
+typedef struct SelfTestTimer {
+    std::chrono::steady_clock::time_point start;
+} SelfTestTimer;
+
+inline SelfTestTimer StartSelfTestTimer(void)
+{
+    SelfTestTimer timer = { std::chrono::steady_clock::now() };
+    return timer;
+}
+
+inline double SelfTestElapsedMs(const SelfTestTimer &timer)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - timer.start).count();
+}
+
+inline Layer EmptySelfTestLayer(int shapeType)
+{
+    Layer layer;
+    layer.shapeType = shapeType;
+    layer.featureCount = 0;
+    layer.bounds = EmptyBounds();
+    layer.featurePart.push_back(0);
+    layer.partStart.push_back(0);
+    return layer;
+}
+
+// Append a closed star-shaped ring of 'count' vertices around (cx, cy), clockwise for
+// outer rings and counter-clockwise for holes as in a shapefile
+inline void AppendSelfTestRing(std::mt19937 *rng, double cx, double cy, double radius, int count, bool hole,
+                               std::vector<double> *xs, std::vector<double> *ys, std::vector<int> *parts)
+{
+    std::uniform_real_distribution<double> jitter(0.5, 1.0);
+    parts->push_back((int)xs->size());
+    int first = (int)xs->size();
+    for (int i = 0; i < count; i++)
+    {
+        double angle = 2.0*PROJECTION_PI*i/count*(hole ? 1.0 : -1.0);
+        double r = radius*jitter(*rng);
+        xs->push_back(cx + r*cos(angle));
+        ys->push_back(cy + r*sin(angle));
+    }
+    xs->push_back((*xs)[first]);
+    ys->push_back((*ys)[first]);
+}
+
+// Overlapping star polygons over a square of 'extent' map units, a third of them with a
+// hole and a tenth with a second part
+inline Layer RandomPolygonLayer(int featureCount, double extent, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> position(0.0, extent), size(0.5, 4.0);
+    std::uniform_int_distribution<int> vertices(6, 64), kind(0, 29);
+
+    Layer layer = EmptySelfTestLayer(SHPT_POLYGON);
+    std::vector<double> xs, ys;
+    std::vector<int> parts;
+    for (int f = 0; f < featureCount; f++)
+    {
+        xs.clear();
+        ys.clear();
+        parts.clear();
+        double cx = position(rng), cy = position(rng), radius = size(rng);
+        int shape = kind(rng);
+        AppendSelfTestRing(&rng, cx, cy, radius, vertices(rng), false, &xs, &ys, &parts);
+        if (shape < 10) AppendSelfTestRing(&rng, cx, cy, 0.4*radius, vertices(rng), true, &xs, &ys, &parts);
+        if (shape < 3) AppendSelfTestRing(&rng, cx + 2.5*radius, cy, 0.5*radius, vertices(rng), false, &xs, &ys, &parts);
+
+        SHPObject *obj = SHPCreateObject(SHPT_POLYGON, -1, (int)parts.size(), parts.data(), NULL,
+                                         (int)xs.size(), xs.data(), ys.data(), NULL, NULL);
+        LayerAppendObject(&layer, obj);
+        SHPDestroyObject(obj);
+    }
+    return layer;
+}
+
+// Random query points over the layer extent and a margin around it
+inline void RandomSelfTestPoints(const Bounds &bounds, int count, unsigned int seed, std::vector<double> *px, std::vector<double> *py)
+{
+    std::mt19937 rng(seed);
+    double mx = 0.05*(bounds.maxX - bounds.minX), my = 0.05*(bounds.maxY - bounds.minY);
+    std::uniform_real_distribution<double> x(bounds.minX - mx, bounds.maxX + mx), y(bounds.minY - my, bounds.maxY + my);
+    px->resize(count);
+    py->resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        (*px)[i] = x(rng);
+        (*py)[i] = y(rng);
+    }
+}
+
+// SpatialIndexPointInPolygon and SpatialIndexNearest against a scan of every feature,
+// with the cost of a viewer pick (the polygon under the point, else the nearest one)
+inline int SelfTestSpatialIndex(const Layer &layer, int queryCount, unsigned int seed)
+{
+    SelfTestTimer build = StartSelfTestTimer();
+    SpatialIndex index = BuildLayerIndex(layer);
+    double buildMs = SelfTestElapsedMs(build);
+
+    std::vector<double> px, py;
+    RandomSelfTestPoints(layer.bounds, queryCount, seed, &px, &py);
+
+    // Picks are timed one by one, the slowest matters as much as the mean
+    std::vector<int> hits;
+    double totalMs = 0.0, slowestMs = 0.0;
+    for (int q = 0; q < queryCount; q++)
+    {
+        SelfTestTimer pick = StartSelfTestTimer();
+        SpatialIndexPointInPolygon(index, layer, px[q], py[q], &hits);
+        if (hits.empty()) SpatialIndexNearest(index, layer, px[q], py[q], 1, SELFTEST_PICK_RADIUS, &hits, NULL);
+        double ms = SelfTestElapsedMs(pick);
+        totalMs += ms;
+        slowestMs = std::max(slowestMs, ms);
+    }
+
+    int failures = 0;
+    std::vector<int> expected;
+    std::vector<double> distances, exact;
+    int checkCount = std::min(queryCount, SELFTEST_CHECKS);
+    for (int q = 0; q < checkCount; q++)
+    {
+        expected.clear();
+        exact.clear();
+        for (int f = 0; f < layer.featureCount; f++)
+        {
+            if (FeatureContainsPoint(layer, f, px[q], py[q])) expected.push_back(f);
+            exact.push_back(FeatureDistanceSq(layer, f, px[q], py[q]));
+        }
+
+        SpatialIndexPointInPolygon(index, layer, px[q], py[q], &hits);
+        std::sort(hits.begin(), hits.end());
+        if (hits != expected) failures++;
+
+        // Ties may come in any order, so the distances are compared rather than the ids
+        std::sort(exact.begin(), exact.end());
+        exact.resize(std::min((int)exact.size(), SELFTEST_NEAREST_K));
+        for (int i = 0; i < (int)exact.size(); i++) exact[i] = sqrt(exact[i]);
+        SpatialIndexNearest(index, layer, px[q], py[q], SELFTEST_NEAREST_K, 0.0, &hits, &distances);
+        if (distances != exact) failures++;
+    }
+
+    printf("spatial index: %i features, built in %.1f ms\n", layer.featureCount, buildMs);
+    printf("  pick: %.4f ms mean, %.4f ms slowest over %i queries\n", totalMs/std::max(queryCount, 1), slowestMs, queryCount);
+    printf("  point in polygon and %i nearest vs brute force: %i queries, %i failures\n", SELFTEST_NEAREST_K, checkCount, failures);
+    return failures;
+}
+
+// QuantizeChunk then DequantizeValue on the vertices under random tile boxes, from the
+// whole layer down to a thousandth of it; every decoded vertex must lie within
+// QuantizationErrorBound of its source position
+inline int SelfTestQuantize(const Layer &layer, int tileCount, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    double w = layer.bounds.maxX - layer.bounds.minX, h = layer.bounds.maxY - layer.bounds.minY;
+
+    int failures = 0;
+    long long vertexCount = 0;
+    double worstRatio = 0.0;
+    for (int t = 0; t < tileCount; t++)
+    {
+        // Tile sizes spread evenly in log scale, the tile clamped to the layer extent
+        double scale = pow(1000.0, -unit(rng));
+        Bounds tile;
+        tile.minX = layer.bounds.minX + unit(rng)*w*(1.0 - scale);
+        tile.minY = layer.bounds.minY + unit(rng)*h*(1.0 - scale);
+        tile.maxX = tile.minX + w*scale;
+        tile.maxY = tile.minY + h*scale;
+
+        // Same float layout as BuildFillChunks with the tile corner as origin
+        MeshChunkData chunk;
+        std::vector<int> sources;
+        for (int v = 0; v < (int)layer.x.size(); v++)
+        {
+            if (!BoundsContainsPoint(tile, layer.x[v], layer.y[v])) continue;
+            chunk.vertices.push_back((float)(layer.x[v] - tile.minX));
+            chunk.vertices.push_back((float)(layer.y[v] - tile.minY));
+            chunk.vertices.push_back(0.0f);
+            sources.push_back(v);
+        }
+
+        QuantizedChunkData quantized = QuantizeChunk(chunk, tile);
+        double ex = QuantizeExtent(tile.maxX - tile.minX), ey = QuantizeExtent(tile.maxY - tile.minY);
+        double bound = QuantizationErrorBound(tile);
+        for (int i = 0; i < (int)sources.size(); i++)
+        {
+            double dx = DequantizeValue(quantized.positions[2*i], tile.minX, ex) - layer.x[sources[i]];
+            double dy = DequantizeValue(quantized.positions[2*i + 1], tile.minY, ey) - layer.y[sources[i]];
+            double error = sqrt(dx*dx + dy*dy);
+            if (error > bound) failures++;
+            worstRatio = std::max(worstRatio, error/bound);
+        }
+        vertexCount += (long long)sources.size();
+    }
+
+    printf("quantize: %i tiles, %lld vertices, worst error %.3f of the bound, %i failures\n", tileCount, vertexCount, worstRatio, failures);
+    return failures;
+}
+
+// PointsInPolygonsPairs against FeatureContainsPoint on every candidate of the R-tree.
+// Besides random points the batch holds every vertex of the first polygons and points
+// on their slab boundaries and one ulp either side, where the slab of a point and of
+// an edge must agree; the count is kept odd so the kernel's scalar tail runs.
+inline int SelfTestPointsInPolygons(const Layer &layer, JobSystem *jobs, unsigned int seed)
+{
+    std::vector<double> px, py;
+    RandomSelfTestPoints(layer.bounds, SELFTEST_JOIN_POINTS, seed, &px, &py);
+
+    SelfTestTimer build = StartSelfTestTimer();
+    PipIndex pipIndex = BuildPipIndex(layer, jobs);
+    double buildMs = SelfTestElapsedMs(build);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    int features = std::min(layer.featureCount, SELFTEST_JOIN_FEATURES);
+    for (int f = 0; f < features; f++)
+    {
+        for (int v = layer.partStart[layer.featurePart[f]]; v < layer.partStart[layer.featurePart[f + 1]]; v++)
+        {
+            px.push_back(layer.x[v]);
+            py.push_back(layer.y[v]);
+        }
+
+        const Bounds &b = pipIndex.bounds[f];
+        int slabs = pipIndex.firstSlab[f + 1] - pipIndex.firstSlab[f];
+        for (int s = 1; s < slabs; s++)
+        {
+            double y = b.minY + s/pipIndex.slabScale[f];
+            double x = b.minX + unit(rng)*(b.maxX - b.minX);
+            double ys[3] = { nextafter(y, -DBL_MAX), y, nextafter(y, DBL_MAX) };
+            for (int i = 0; i < 3; i++)
+            {
+                px.push_back(x);
+                py.push_back(ys[i]);
+            }
+        }
+    }
+    if (px.size()%2 == 0)
+    {
+        px.push_back(layer.x[0]);
+        py.push_back(layer.y[0]);
+    }
+    int count = (int)px.size();
+
+    SelfTestTimer join = StartSelfTestTimer();
+    std::vector<JoinPair> pairs = PointsInPolygonsPairs(pipIndex, px.data(), py.data(), count, jobs);
+    double joinMs = SelfTestElapsedMs(join);
+
+    // Both lists are sorted by point then polygon, compare them point by point
+    int failures = 0;
+    size_t next = 0;
+    std::vector<int> hits;
+    for (int k = 0; k < count; k++)
+    {
+        SpatialIndexPointInPolygon(pipIndex.index, layer, px[k], py[k], &hits);
+        std::sort(hits.begin(), hits.end());
+        bool same = true;
+        for (int i = 0; i < (int)hits.size(); i++, next++)
+        {
+            if (next >= pairs.size() || pairs[next].left != k || pairs[next].right != hits[i]) same = false;
+        }
+        while (next < pairs.size() && pairs[next].left == k)
+        {
+            same = false;
+            next++;
+        }
+        if (!same) failures++;
+    }
+
+    printf("points in polygons: %i points, index built in %.1f ms, joined in %.1f ms\n", count, buildMs, joinMs);
+    printf("  vs FeatureContainsPoint: %i pairs, %i failures\n", (int)pairs.size(), failures);
+    return failures;
+}
+
+#endif // VECTORMAP_SELF_TEST_H
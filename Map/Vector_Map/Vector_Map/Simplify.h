@@ -0,0 +1,318 @@
+#ifndef VECTORMAP_SIMPLIFY_H
+#define VECTORMAP_SIMPLIFY_H
+
+#include "Layer.h"
+#include "Geometry.h"
+#include "JobSystem.h"
+#include <vector>
+#include <algorithm>
+
+#define LOD_LEVEL_STEP 4.0          // Tolerance ratio between consecutive levels
+
+//------------------------------------------------------------------------------------
+// Simplify - Douglas-Peucker level-of-detail pyramid
+//
+// Every part is simplified on its own and keeps its shape class: lines keep both ends,
+// polygon rings stay closed with at least three distinct vertices, so no feature, part
+// or hole disappears at a coarse level. Spans of one feature that would cross get
+// vertices back until they do not, so rings stay simple and holes inside their outer
+// ring for the triangulator. Rings that share a border with a neighbour are
+// simplified independently and may open slivers along it at the coarsest levels;
+// BuildTopologyLod (Topology.h) simplifies shared borders once instead.
+//------------------------------------------------------------------------------------
+
+// Mark the vertices of [first, last] kept by Douglas-Peucker, both ends are kept by the caller
+inline void DouglasPeucker(const double *xs, const double *ys, int first, int last, double toleranceSq, std::vector<char> *keep)
+{
+    std::vector<int> stack;
+    stack.push_back(first);
+    stack.push_back(last);
+
+    while (!stack.empty())
+    {
+        int b = stack.back(); stack.pop_back();
+        int a = stack.back(); stack.pop_back();
+
+        int farthest = -1;
+        double farthestSq = toleranceSq;
+        for (int i = a + 1; i < b; i++)
+        {
+            double d = PointSegmentDistanceSq(xs[i], ys[i], xs[a], ys[a], xs[b], ys[b]);
+            if (d > farthestSq)
+            {
+                farthest = i;
+                farthestSq = d;
+            }
+        }
+
+        if (farthest < 0) continue;
+        (*keep)[farthest] = 1;
+        stack.push_back(a);
+        stack.push_back(farthest);
+        stack.push_back(farthest);
+        stack.push_back(b);
+    }
+}
+
+// Mark the vertices of one part kept at 'tolerance' in keep[0..count)
+inline void SimplifyMarkPart(const double *xs, const double *ys, int count, bool ring, double tolerance, char *keep)
+{
+    // Rings need 4 vertices (3 + closing), lines 2, anything at the minimum is kept as is
+    if (count <= (ring ? 4 : 2) || tolerance <= 0.0)
+    {
+        for (int i = 0; i < count; i++) keep[i] = 1;
+        return;
+    }
+
+    std::vector<char> marks(count, 0);
+    marks[0] = 1;
+    marks[count - 1] = 1;
+
+    if (ring)
+    {
+        // The closing vertex repeats the first one, split the ring at the vertex farthest from it
+        int split = 1;
+        double splitSq = -1.0;
+        for (int i = 1; i < count - 1; i++)
+        {
+            double dx = xs[i] - xs[0], dy = ys[i] - ys[0];
+            if (dx*dx + dy*dy > splitSq)
+            {
+                split = i;
+                splitSq = dx*dx + dy*dy;
+            }
+        }
+        marks[split] = 1;
+        DouglasPeucker(xs, ys, 0, split, tolerance*tolerance, &marks);
+        DouglasPeucker(xs, ys, split, count - 1, tolerance*tolerance, &marks);
+
+        // A ring collapsed to a spike gets back the vertex farthest from it
+        int kept = 0;
+        for (int i = 0; i < count - 1; i++) kept += marks[i];
+        if (kept < 3)
+        {
+            int third = -1;
+            double thirdSq = -1.0;
+            for (int i = 1; i < count - 1; i++)
+            {
+                if (marks[i]) continue;
+                double d = PointSegmentDistanceSq(xs[i], ys[i], xs[0], ys[0], xs[split], ys[split]);
+                if (d > thirdSq)
+                {
+                    third = i;
+                    thirdSq = d;
+                }
+            }
+            if (third >= 0) marks[third] = 1;
+        }
+    }
+    else DouglasPeucker(xs, ys, 0, count - 1, tolerance*tolerance, &marks);
+
+    for (int i = 0; i < count; i++) keep[i] = marks[i];
+}
+
+// Simplify the count vertices of one part and append the survivors to outX/outY
+inline void SimplifyPart(const double *xs, const double *ys, int count, bool ring, double tolerance,
+                         std::vector<double> *outX, std::vector<double> *outY)
+{
+    std::vector<char> keep(count, 0);
+    SimplifyMarkPart(xs, ys, count, ring, tolerance, keep.data());
+    for (int i = 0; i < count; i++)
+    {
+        if (!keep[i]) continue;
+        outX->push_back(xs[i]);
+        outY->push_back(ys[i]);
+    }
+}
+
+// Simplified span of a feature: the kept vertices a and b with nothing kept between them
+typedef struct SimplifySpan {
+    int a;
+    int b;
+} SimplifySpan;
+
+// Put back the farthest dropped vertex of span s, false when it has none
+inline bool SimplifyRefineSpan(const Layer &layer, const SimplifySpan &s, std::vector<char> *keep, int base)
+{
+    int farthest = -1;
+    double farthestSq = -1.0;
+    for (int v = s.a + 1; v < s.b; v++)
+    {
+        double d = PointSegmentDistanceSq(layer.x[v], layer.y[v], layer.x[s.a], layer.y[s.a], layer.x[s.b], layer.y[s.b]);
+        if (d > farthestSq)
+        {
+            farthest = v;
+            farthestSq = d;
+        }
+    }
+    if (farthest < 0 || (*keep)[farthest - base]) return false;
+    (*keep)[farthest - base] = 1;
+    return true;
+}
+
+// Keep flags for the vertices of feature f (keep[v - first vertex of f]). Parts are
+// simplified on their own, then spans that properly cross another span of the same
+// feature, its own part or another one (a hole pushed over its outer ring), get their
+// farthest vertex back until none cross. Only crossings the source itself has remain.
+inline void SimplifyFeatureMarks(const Layer &layer, int f, double tolerance, bool ring, std::vector<char> *keep)
+{
+    int base = layer.partStart[layer.featurePart[f]];
+    int end = layer.partStart[layer.featurePart[f + 1]];
+    keep->assign(end - base, 1);
+    for (int p = layer.featurePart[f]; p < layer.featurePart[f + 1]; p++)
+    {
+        int first = layer.partStart[p];
+        SimplifyMarkPart(&layer.x[first], &layer.y[first], layer.partStart[p + 1] - first, ring, tolerance, keep->data() + first - base);
+    }
+    if (tolerance <= 0.0) return;
+
+    std::vector<SimplifySpan> spans;
+    std::vector<int> order, active;
+    for (;;)
+    {
+        spans.clear();
+        for (int p = layer.featurePart[f]; p < layer.featurePart[f + 1]; p++)
+        {
+            int a = -1;
+            for (int v = layer.partStart[p]; v < layer.partStart[p + 1]; v++)
+            {
+                if (!(*keep)[v - base]) continue;
+                if (a >= 0)
+                {
+                    SimplifySpan span = { a, v };
+                    spans.push_back(span);
+                }
+                a = v;
+            }
+        }
+        if (spans.size() < 2) return;
+
+        // Sweep the spans by their left end against the active ones overlapping in x
+        const double *x = layer.x.data(), *y = layer.y.data();
+        order.resize(spans.size());
+        for (int i = 0; i < (int)spans.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int i, int j) {
+            return fmin(x[spans[i].a], x[spans[i].b]) < fmin(x[spans[j].a], x[spans[j].b]);
+        });
+
+        bool changed = false;
+        active.clear();
+        for (int k = 0; k < (int)order.size(); k++)
+        {
+            const SimplifySpan &e = spans[order[k]];
+            double left = fmin(x[e.a], x[e.b]);
+            int kept = 0;
+            for (int m = 0; m < (int)active.size(); m++)
+            {
+                const SimplifySpan &g = spans[active[m]];
+                if (fmax(x[g.a], x[g.b]) < left) continue;
+                active[kept++] = active[m];
+
+                // Proper crossings only, spans sharing an end meet there and do not cross
+                int o1 = Orient2DSign(x[e.a], y[e.a], x[e.b], y[e.b], x[g.a], y[g.a]);
+                int o2 = Orient2DSign(x[e.a], y[e.a], x[e.b], y[e.b], x[g.b], y[g.b]);
+                int o3 = Orient2DSign(x[g.a], y[g.a], x[g.b], y[g.b], x[e.a], y[e.a]);
+                int o4 = Orient2DSign(x[g.a], y[g.a], x[g.b], y[g.b], x[e.b], y[e.b]);
+                if (o1*o2 >= 0 || o3*o4 >= 0) continue;
+                if (SimplifyRefineSpan(layer, e, keep, base)) changed = true;
+                if (SimplifyRefineSpan(layer, g, keep, base)) changed = true;
+            }
+            active.resize(kept);
+            active.push_back(order[k]);
+        }
+        if (!changed) return;
+    }
+}
+
+// Copy of the layer with every part simplified to 'tolerance' (map units). Feature and part
+// numbering, bounds and columns are those of the source. Simplified parts of one feature
+// do not cross each other or themselves where the source did not (see
+// SimplifyFeatureMarks); parts of different features are not checked against each other.
+inline Layer SimplifyLayer(const Layer &layer, double tolerance)
+{
+    Layer simple;
+    simple.shapeType = layer.shapeType;
+    simple.featureCount = layer.featureCount;
+    simple.bounds = layer.bounds;
+    simple.featureBounds = layer.featureBounds;
+    simple.featurePart = layer.featurePart;
+    simple.partStart.reserve(layer.partStart.size());
+    simple.partStart.push_back(0);
+
+    bool ring = IsPolygonType(layer.shapeType);
+    bool points = IsPointType(layer.shapeType);
+
+    std::vector<char> keep;
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        int base = layer.partStart[layer.featurePart[f]];
+        SimplifyFeatureMarks(layer, f, points ? 0.0 : tolerance, ring, &keep);
+        for (int p = layer.featurePart[f]; p < layer.featurePart[f + 1]; p++)
+        {
+            for (int v = layer.partStart[p]; v < layer.partStart[p + 1]; v++)
+            {
+                if (!keep[v - base]) continue;
+                simple.x.push_back(layer.x[v]);
+                simple.y.push_back(layer.y[v]);
+            }
+            simple.partStart.push_back((int)simple.x.size());
+        }
+    }
+
+    return simple;
+}
+
+//------------------------------------------------------------------------------------
+// LayerLod - simplified copies of a layer, level 0 is the source itself
+//------------------------------------------------------------------------------------
+typedef struct LayerLod {
+    std::vector<double> tolerance;      // Per level, 0 for level 0
+    std::vector<Layer> levels;          // Levels 1..n, level i is levels[i - 1]
+} LayerLod;
+
+// Level 1 simplifies to baseTolerance, every further level LOD_LEVEL_STEP times coarser.
+// With a job system the levels are built in parallel.
+inline LayerLod BuildLayerLod(const Layer &layer, double baseTolerance, int levelCount, JobSystem *jobs = NULL)
+{
+    LayerLod lod;
+    lod.tolerance.push_back(0.0);
+
+    double tolerance = baseTolerance;
+    for (int i = 1; i < levelCount; i++)
+    {
+        lod.tolerance.push_back(tolerance);
+        tolerance *= LOD_LEVEL_STEP;
+    }
+
+    lod.levels.resize(lod.tolerance.size() - 1);
+    auto build = [&](int first, int last) {
+        for (int i = first; i < last; i++) lod.levels[i] = SimplifyLayer(layer, lod.tolerance[i + 1]);
+    };
+    if (jobs != NULL) ParallelFor(jobs, (int)lod.levels.size(), 1, build);
+    else build(0, (int)lod.levels.size());
+
+    return lod;
+}
+
+inline int LayerLodLevelCount(const LayerLod &lod)
+{
+    return (int)lod.tolerance.size();
+}
+
+inline const Layer &LayerLodLevel(const LayerLod &lod, const Layer &source, int level)
+{
+    return (level <= 0) ? source : lod.levels[level - 1];
+}
+
+// Coarsest level whose error stays below 'tolerance', e.g. half a pixel in map units
+inline int LayerLodSelect(const LayerLod &lod, double tolerance)
+{
+    int level = 0;
+    for (int i = 1; i < LayerLodLevelCount(lod); i++)
+    {
+        if (lod.tolerance[i] <= tolerance) level = i;
+    }
+    return level;
+}
+
+#endif // VECTORMAP_SIMPLIFY_H
@@ -0,0 +1,401 @@
+#ifndef VECTORMAP_SPATIAL_INDEX_H
+#define VECTORMAP_SPATIAL_INDEX_H
+
+#include "Layer.h"
+#include "Geometry.h"
+#include <vector>
+#include <queue>
+#include <algorithm>
+
+#define SPATIAL_INDEX_NODE_SIZE 16
+
+//------------------------------------------------------------------------------------
+// SpatialIndex - static packed R-tree over the feature boxes of a layer
+//
+// Items are Hilbert-sorted and packed bottom-up, so the whole tree lives in flat parallel
+// arrays: slots [0, itemCount) are the features, every level above follows. For an item
+// slot indices[] holds the feature id, for a node slot the first slot of its children.
+// counts[] is the number of features under each slot, so covered subtrees can be
+// counted without being visited.
+//------------------------------------------------------------------------------------
+typedef struct SpatialIndex {
+    int nodeSize;
+    int itemCount;
+    std::vector<Bounds> boxes;
+    std::vector<int> indices;
+    std::vector<int> counts;
+    std::vector<int> levelBounds;   // End slot of each level, leaves first
+} SpatialIndex;
+
+// Position of (x, y) on a 2^16 x 2^16 Hilbert curve
+inline unsigned int HilbertIndex(unsigned int x, unsigned int y)
+{
+    unsigned int a = x ^ y;
+    unsigned int b = 0xFFFF ^ a;
+    unsigned int c = 0xFFFF ^ (x | y);
+    unsigned int d = x & (y ^ 0xFFFF);
+
+    unsigned int A = a | (b >> 1);
+    unsigned int B = (a >> 1) ^ a;
+    unsigned int C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    unsigned int D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    unsigned int i0 = x ^ y;
+    unsigned int i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+// Hilbert value of a point inside the given extent
+inline unsigned int HilbertIndexInBounds(const Bounds &extent, double x, double y)
+{
+    double w = extent.maxX - extent.minX;
+    double h = extent.maxY - extent.minY;
+    unsigned int hx = (w > 0.0) ? (unsigned int)(65535.0*(x - extent.minX)/w) : 0;
+    unsigned int hy = (h > 0.0) ? (unsigned int)(65535.0*(y - extent.minY)/h) : 0;
+    return HilbertIndex(hx, hy);
+}
+
+// Slot one past the last slot of the level that contains 'slot'
+inline int SpatialIndexLevelEnd(const SpatialIndex &index, int slot)
+{
+    return *std::upper_bound(index.levelBounds.begin(), index.levelBounds.end(), slot);
+}
+
+// Bulk load the index from a set of boxes, empty boxes are skipped
+inline SpatialIndex BuildSpatialIndex(const std::vector<Bounds> &boxes, int nodeSize)
+{
+    SpatialIndex index;
+    index.nodeSize = (nodeSize < 2) ? 2 : nodeSize;
+    index.itemCount = 0;
+
+    Bounds extent = EmptyBounds();
+    std::vector<int> items;
+    items.reserve(boxes.size());
+    for (int i = 0; i < (int)boxes.size(); i++)
+    {
+        if (BoundsIsEmpty(boxes[i])) continue;
+        items.push_back(i);
+        BoundsMerge(&extent, boxes[i]);
+    }
+
+    int n = (int)items.size();
+    if (n == 0) return index;
+    index.itemCount = n;
+
+    std::vector<unsigned int> hilbert(boxes.size());
+    for (int i = 0; i < n; i++)
+    {
+        const Bounds &b = boxes[items[i]];
+        hilbert[items[i]] = HilbertIndexInBounds(extent, 0.5*(b.minX + b.maxX), 0.5*(b.minY + b.maxY));
+    }
+    std::sort(items.begin(), items.end(), [&hilbert](int a, int b) { return hilbert[a] < hilbert[b]; });
+
+    int numNodes = n;
+    int levelCount = n;
+    index.levelBounds.push_back(n);
+    do
+    {
+        levelCount = (levelCount + index.nodeSize - 1)/index.nodeSize;
+        numNodes += levelCount;
+        index.levelBounds.push_back(numNodes);
+    } while (levelCount != 1);
+
+    index.boxes.reserve(numNodes);
+    index.indices.reserve(numNodes);
+    index.counts.reserve(numNodes);
+    for (int i = 0; i < n; i++)
+    {
+        index.boxes.push_back(boxes[items[i]]);
+        index.indices.push_back(items[i]);
+        index.counts.push_back(1);
+    }
+
+    int levelStart = 0;
+    for (int level = 0; level + 1 < (int)index.levelBounds.size(); level++)
+    {
+        int levelEnd = index.levelBounds[level];
+        for (int pos = levelStart; pos < levelEnd; pos += index.nodeSize)
+        {
+            Bounds nodeBox = EmptyBounds();
+            int nodeCount = 0;
+            int end = std::min(pos + index.nodeSize, levelEnd);
+            for (int c = pos; c < end; c++)
+            {
+                BoundsMerge(&nodeBox, index.boxes[c]);
+                nodeCount += index.counts[c];
+            }
+            index.boxes.push_back(nodeBox);
+            index.indices.push_back(pos);
+            index.counts.push_back(nodeCount);
+        }
+        levelStart = levelEnd;
+    }
+
+    return index;
+}
+
+inline SpatialIndex BuildLayerIndex(const Layer &layer)
+{
+    return BuildSpatialIndex(layer.featureBounds, SPATIAL_INDEX_NODE_SIZE);
+}
+
+// Collect the ids of every feature whose box intersects the query box
+inline void SpatialIndexSearch(const SpatialIndex &index, const Bounds &query, std::vector<int> *result)
+{
+    result->clear();
+    if (index.itemCount == 0) return;
+
+    std::vector<int> stack;
+    int nodeIndex = (int)index.boxes.size() - 1;
+
+    for (;;)
+    {
+        int end = std::min(nodeIndex + index.nodeSize, SpatialIndexLevelEnd(index, nodeIndex));
+
+        for (int pos = nodeIndex; pos < end; pos++)
+        {
+            if (!BoundsIntersect(query, index.boxes[pos])) continue;
+
+            if (nodeIndex < index.itemCount) result->push_back(index.indices[pos]);
+            else stack.push_back(index.indices[pos]);
+        }
+
+        if (stack.empty()) break;
+        nodeIndex = stack.back();
+        stack.pop_back();
+    }
+}
+
+// Ids of the polygon features containing (x, y), tested against the exact rings
+inline void SpatialIndexPointInPolygon(const SpatialIndex &index, const Layer &layer, double x, double y, std::vector<int> *result)
+{
+    Bounds query = { x, y, x, y };
+    std::vector<int> candidates;
+    SpatialIndexSearch(index, query, &candidates);
+
+    result->clear();
+    for (int i = 0; i < (int)candidates.size(); i++)
+    {
+        if (FeatureContainsPoint(layer, candidates[i], x, y)) result->push_back(candidates[i]);
+    }
+}
+
+// Number of features whose box intersects the query, same set as SpatialIndexSearch.
+// Subtrees whose box lies inside the query are taken from counts[] without descending.
+inline int SpatialIndexCount(const SpatialIndex &index, const Bounds &query)
+{
+    if (index.itemCount == 0) return 0;
+
+    int count = 0;
+    std::vector<int> stack;
+    int nodeIndex = (int)index.boxes.size() - 1;
+
+    for (;;)
+    {
+        int end = std::min(nodeIndex + index.nodeSize, SpatialIndexLevelEnd(index, nodeIndex));
+
+        for (int pos = nodeIndex; pos < end; pos++)
+        {
+            if (!BoundsIntersect(query, index.boxes[pos])) continue;
+
+            if (nodeIndex < index.itemCount || BoundsContainsBounds(query, index.boxes[pos])) count += index.counts[pos];
+            else stack.push_back(index.indices[pos]);
+        }
+
+        if (stack.empty()) break;
+        nodeIndex = stack.back();
+        stack.pop_back();
+    }
+
+    return count;
+}
+
+//------------------------------------------------------------------------------------
+// IndexAggregate - per-slot summary of one attribute column over a SpatialIndex
+//------------------------------------------------------------------------------------
+typedef struct AggregateValue {
+    int count;              // Features matched
+    int valueCount;         // Of which have a non-NULL value
+    double sum;
+    double min;
+    double max;
+} AggregateValue;
+
+typedef struct IndexAggregate {
+    std::vector<AggregateValue> values;     // One per index slot
+} IndexAggregate;
+
+inline AggregateValue EmptyAggregateValue(void)
+{
+    AggregateValue v = { 0, 0, 0.0, DBL_MAX, -DBL_MAX };
+    return v;
+}
+
+inline void AggregateMerge(AggregateValue *a, const AggregateValue &b)
+{
+    a->count += b.count;
+    a->valueCount += b.valueCount;
+    a->sum += b.sum;
+    if (b.min < a->min) a->min = b.min;
+    if (b.max > a->max) a->max = b.max;
+}
+
+// Summarise a column of featureCount values (NAN for NULL) bottom-up over the index slots
+inline IndexAggregate BuildIndexAggregate(const SpatialIndex &index, const std::vector<double> &column)
+{
+    IndexAggregate aggregate;
+    aggregate.values.assign(index.boxes.size(), EmptyAggregateValue());
+
+    for (int pos = 0; pos < index.itemCount; pos++)
+    {
+        AggregateValue &v = aggregate.values[pos];
+        double value = (index.indices[pos] < (int)column.size()) ? column[index.indices[pos]] : NAN;
+        v.count = 1;
+        if (!isnan(value))
+        {
+            v.valueCount = 1;
+            v.sum = value;
+            v.min = value;
+            v.max = value;
+        }
+    }
+
+    // Parents always follow their children, one forward pass fills every level
+    for (int pos = index.itemCount; pos < (int)index.boxes.size(); pos++)
+    {
+        int first = index.indices[pos];
+        int end = std::min(first + index.nodeSize, SpatialIndexLevelEnd(index, first));
+        for (int c = first; c < end; c++) AggregateMerge(&aggregate.values[pos], aggregate.values[c]);
+    }
+
+    return aggregate;
+}
+
+// Count, sum, min and max of the column over the features whose box intersects the query
+inline AggregateValue SpatialIndexAggregate(const SpatialIndex &index, const IndexAggregate &aggregate, const Bounds &query)
+{
+    AggregateValue result = EmptyAggregateValue();
+    if (index.itemCount == 0) return result;
+
+    std::vector<int> stack;
+    int nodeIndex = (int)index.boxes.size() - 1;
+
+    for (;;)
+    {
+        int end = std::min(nodeIndex + index.nodeSize, SpatialIndexLevelEnd(index, nodeIndex));
+
+        for (int pos = nodeIndex; pos < end; pos++)
+        {
+            if (!BoundsIntersect(query, index.boxes[pos])) continue;
+
+            if (nodeIndex < index.itemCount || BoundsContainsBounds(query, index.boxes[pos])) AggregateMerge(&result, aggregate.values[pos]);
+            else stack.push_back(index.indices[pos]);
+        }
+
+        if (stack.empty()) break;
+        nodeIndex = stack.back();
+        stack.pop_back();
+    }
+
+    return result;
+}
+
+typedef struct NearestCandidate {
+    double distSq;
+    int slot;               // Tree slot, or the feature id once 'exact' is set
+    bool exact;
+} NearestCandidate;
+
+struct NearestCandidateGreater {
+    bool operator()(const NearestCandidate &a, const NearestCandidate &b) const { return a.distSq > b.distSq; }
+};
+
+// k nearest features to (x, y) by exact distance to their geometry, closest first.
+// Best-first traversal: boxes are expanded by their box distance and features are
+// re-queued with their exact distance, so a feature is emitted only when nothing
+// left in the queue can be closer. maxDist <= 0 means unbounded.
+inline void SpatialIndexNearest(const SpatialIndex &index, const Layer &layer, double x, double y, int k, double maxDist,
+                                std::vector<int> *result, std::vector<double> *distances)
+{
+    result->clear();
+    if (distances != NULL) distances->clear();
+    if (index.itemCount == 0 || k <= 0) return;
+
+    double maxDistSq = (maxDist > 0.0) ? maxDist*maxDist : DBL_MAX;
+    std::priority_queue<NearestCandidate, std::vector<NearestCandidate>, NearestCandidateGreater> queue;
+    int nodeIndex = (int)index.boxes.size() - 1;
+
+    for (;;)
+    {
+        int end = std::min(nodeIndex + index.nodeSize, SpatialIndexLevelEnd(index, nodeIndex));
+
+        for (int pos = nodeIndex; pos < end; pos++)
+        {
+            double d = BoundsDistanceSq(index.boxes[pos], x, y);
+            if (d > maxDistSq) continue;
+            NearestCandidate c = { d, pos, false };
+            queue.push(c);
+        }
+
+        nodeIndex = -1;
+        while (!queue.empty())
+        {
+            NearestCandidate c = queue.top();
+            queue.pop();
+
+            if (c.distSq > maxDistSq) return;
+
+            if (c.exact)
+            {
+                result->push_back(c.slot);
+                if (distances != NULL) distances->push_back(sqrt(c.distSq));
+                if ((int)result->size() == k) return;
+            }
+            else if (c.slot < index.itemCount)
+            {
+                int feature = index.indices[c.slot];
+                NearestCandidate e = { FeatureDistanceSq(layer, feature, x, y), feature, true };
+                queue.push(e);
+            }
+            else
+            {
+                nodeIndex = index.indices[c.slot];
+                break;
+            }
+        }
+
+        if (nodeIndex < 0) return;
+    }
+}
+
+#endif // VECTORMAP_SPATIAL_INDEX_H
@@ -0,0 +1,120 @@
+#ifndef VECTORMAP_SPATIAL_JOIN_H
+#define VECTORMAP_SPATIAL_JOIN_H
+
+#include "Layer.h"
+#include "Geometry.h"
+#include "SpatialIndex.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#define SPATIAL_JOIN_CHUNK 256          // Probe features claimed by a worker at a time
+#define SPATIAL_JOIN_BATCH 4096         // Pairs buffered per worker before they reach the sink
+
+//------------------------------------------------------------------------------------
+// SpatialJoin - batched index-nested-loop join between two layers
+//
+// The right layer is probed through its spatial index, the left layer is split into
+// chunks that worker threads claim from a shared counter. Candidates from the index are
+// confirmed with the exact predicate and streamed to the sink in batches; the sink is
+// called under a lock, one batch at a time, in no particular order.
+//------------------------------------------------------------------------------------
+typedef enum {
+    JOIN_INTERSECTS = 0,    // Geometries touch or overlap
+    JOIN_WITHIN,            // Left feature lies inside the right polygon (sensor in district)
+    JOIN_CONTAINS           // Left polygon contains the right feature
+} JoinPredicate;
+
+typedef struct JoinPair {
+    int left;
+    int right;
+} JoinPair;
+
+inline bool JoinTest(JoinPredicate predicate, const Layer &left, int l, const Layer &right, int r)
+{
+    switch (predicate)
+    {
+        case JOIN_WITHIN: return FeatureWithin(left, l, right, r);
+        case JOIN_CONTAINS: return FeatureWithin(right, r, left, l);
+        default: return FeaturesIntersect(left, l, right, r);
+    }
+}
+
+inline int JoinThreadCount(int threadCount)
+{
+    if (threadCount > 0) return threadCount;
+    int hardware = (int)std::thread::hardware_concurrency();
+    return (hardware > 0) ? hardware : 1;
+}
+
+// Sink is any callable taking (const JoinPair *pairs, int count).
+// threadCount <= 0 uses every hardware thread.
+template <typename Sink>
+inline void SpatialJoin(const Layer &left, const Layer &right, const SpatialIndex &rightIndex,
+                        JoinPredicate predicate, int threadCount, Sink sink)
+{
+    std::atomic<int> next(0);
+    std::mutex sinkMutex;
+
+    auto worker = [&]() {
+        std::vector<int> candidates;
+        std::vector<JoinPair> batch;
+        batch.reserve(SPATIAL_JOIN_BATCH);
+
+        for (;;)
+        {
+            int first = next.fetch_add(SPATIAL_JOIN_CHUNK);
+            if (first >= left.featureCount) break;
+            int last = (first + SPATIAL_JOIN_CHUNK < left.featureCount) ? first + SPATIAL_JOIN_CHUNK : left.featureCount;
+
+            for (int l = first; l < last; l++)
+            {
+                if (BoundsIsEmpty(left.featureBounds[l])) continue;
+                SpatialIndexSearch(rightIndex, left.featureBounds[l], &candidates);
+
+                for (int i = 0; i < (int)candidates.size(); i++)
+                {
+                    if (!JoinTest(predicate, left, l, right, candidates[i])) continue;
+
+                    JoinPair pair = { l, candidates[i] };
+                    batch.push_back(pair);
+                    if ((int)batch.size() == SPATIAL_JOIN_BATCH)
+                    {
+                        std::lock_guard<std::mutex> lock(sinkMutex);
+                        sink((const JoinPair *)batch.data(), (int)batch.size());
+                        batch.clear();
+                    }
+                }
+            }
+        }
+
+        if (!batch.empty())
+        {
+            std::lock_guard<std::mutex> lock(sinkMutex);
+            sink((const JoinPair *)batch.data(), (int)batch.size());
+        }
+    };
+
+    int count = JoinThreadCount(threadCount);
+    std::vector<std::thread> threads;
+    for (int t = 1; t < count; t++) threads.push_back(std::thread(worker));
+    worker();
+    for (int t = 0; t < (int)threads.size(); t++) threads[t].join();
+}
+
+// Join into a vector, pairs sorted by left then right id
+inline std::vector<JoinPair> SpatialJoinCollect(const Layer &left, const Layer &right, const SpatialIndex &rightIndex,
+                                                JoinPredicate predicate, int threadCount)
+{
+    std::vector<JoinPair> pairs;
+    SpatialJoin(left, right, rightIndex, predicate, threadCount, [&pairs](const JoinPair *batch, int count) {
+        pairs.insert(pairs.end(), batch, batch + count);
+    });
+    std::sort(pairs.begin(), pairs.end(), [](const JoinPair &a, const JoinPair &b) {
+        return (a.left != b.left) ? a.left < b.left : a.right < b.right;
+    });
+    return pairs;
+}
+
+#endif // VECTORMAP_SPATIAL_JOIN_H
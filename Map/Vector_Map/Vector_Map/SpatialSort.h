@@ -0,0 +1,121 @@
+#ifndef VECTORMAP_SPATIAL_SORT_H
+#define VECTORMAP_SPATIAL_SORT_H
+
+#include "shapefil.h"
+#include "Layer.h"
+#include "SpatialIndex.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <utility>
+
+//------------------------------------------------------------------------------------
+// Spatial sort - rewrite a shapefile in Hilbert order of its features
+//
+// Records are ordered by the Hilbert value of their bounding box centre, so features
+// that are close on the map end up close in the .shp and .dbf and a viewport read turns
+// into a few contiguous ranges. NULL records are kept, at the end of the file.
+//------------------------------------------------------------------------------------
+
+// Record order of a shapefile: order[i] is the source record written at position i
+inline bool SpatialSortOrder(SHPHandle hSHP, std::vector<int> *order)
+{
+    int nEntities = 0, nShapeType = 0;
+    double minBound[4], maxBound[4];
+    SHPGetInfo(hSHP, &nEntities, &nShapeType, minBound, maxBound);
+
+    Bounds extent = { minBound[0], minBound[1], maxBound[0], maxBound[1] };
+    std::vector<std::pair<unsigned long long, int>> keys(nEntities);
+
+    for (int i = 0; i < nEntities; i++)
+    {
+        SHPObject *obj = SHPReadObject(hSHP, i);
+        if (obj == NULL) return false;
+
+        // Empty records set bit 32, above every 32-bit Hilbert value; the index keeps the sort stable
+        unsigned long long key = 1ull << 32;
+        if (obj->nVertices > 0) key = HilbertIndexInBounds(extent, 0.5*(obj->dfXMin + obj->dfXMax), 0.5*(obj->dfYMin + obj->dfYMax));
+        keys[i] = std::make_pair(key, i);
+        SHPDestroyObject(obj);
+    }
+
+    std::sort(keys.begin(), keys.end());
+    order->resize(nEntities);
+    for (int i = 0; i < nEntities; i++) (*order)[i] = keys[i].second;
+    return true;
+}
+
+// Copy a sidecar file (.prj, .cpg) next to the rewritten layer if the source has one
+inline void SpatialSortCopySidecar(const std::string &source, const std::string &target, const char *extension)
+{
+    FILE *in = fopen((source + extension).c_str(), "rb");
+    if (in == NULL) return;
+
+    FILE *out = fopen((target + extension).c_str(), "wb");
+    if (out != NULL)
+    {
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) fwrite(buffer, 1, n, out);
+        fclose(out);
+    }
+    fclose(in);
+}
+
+// Rewrite the .shp/.shx/.dbf of 'source' into 'target' in Hilbert order.
+// Both names may be given with or without extension.
+inline bool SpatialSortShapefile(const char *source, const char *target)
+{
+    std::string sourceBase(source, SHPGetLenWithoutExtension(source));
+    std::string targetBase(target, SHPGetLenWithoutExtension(target));
+    if (sourceBase == targetBase) return false;
+
+    SHPHandle hSHP = SHPOpen(sourceBase.c_str(), "rb");
+    if (hSHP == NULL) return false;
+
+    std::vector<int> order;
+    if (!SpatialSortOrder(hSHP, &order))
+    {
+        SHPClose(hSHP);
+        return false;
+    }
+
+    SHPHandle hOut = SHPCreate(targetBase.c_str(), hSHP->nShapeType);
+    if (hOut == NULL)
+    {
+        SHPClose(hSHP);
+        return false;
+    }
+
+    DBFHandle hDBF = DBFOpen(sourceBase.c_str(), "rb");
+    DBFHandle hDBFOut = (hDBF != NULL) ? DBFCloneEmpty(hDBF, targetBase.c_str()) : NULL;
+    bool ok = (hDBF == NULL) || (hDBFOut != NULL);
+
+    for (int i = 0; ok && i < (int)order.size(); i++)
+    {
+        SHPObject *obj = SHPReadObject(hSHP, order[i]);
+        if (obj == NULL || SHPWriteObject(hOut, -1, obj) != i) ok = false;
+        if (obj != NULL) SHPDestroyObject(obj);
+
+        if (ok && hDBFOut != NULL && order[i] < DBFGetRecordCount(hDBF))
+        {
+            const char *tuple = DBFReadTuple(hDBF, order[i]);
+            if (tuple == NULL || !DBFWriteTuple(hDBFOut, i, tuple)) ok = false;
+        }
+    }
+
+    if (hDBFOut != NULL) DBFClose(hDBFOut);
+    if (hDBF != NULL) DBFClose(hDBF);
+    SHPClose(hOut);
+    SHPClose(hSHP);
+
+    if (ok)
+    {
+        SpatialSortCopySidecar(sourceBase, targetBase, ".prj");
+        SpatialSortCopySidecar(sourceBase, targetBase, ".cpg");
+    }
+
+    return ok;
+}
+
+#endif // VECTORMAP_SPATIAL_SORT_H
@@ -0,0 +1,462 @@
+#ifndef VECTORMAP_TILE_CACHE_H
+#define VECTORMAP_TILE_CACHE_H
+
+#include "raylib.h"
+#include "shapefil.h"
+#include "Layer.h"
+#include "SpatialIndex.h"
+#include "Triangulator.h"
+#include "LayerMesh.h"
+#include "LineMesh.h"
+#include "Simplify.h"
+#include "Quantize.h"
+#include "RectClip.h"
+#include "Prj.h"
+#include "JobSystem.h"
+#include <vector>
+#include <list>
+#include <string>
+#include <mutex>
+#include <math.h>
+
+#define TILE_CACHE_FEATURES 512             // Target features per tile when sizing the grid
+#define TILE_CACHE_MAX_GRID 64              // Tiles per side at most
+#define TILE_CACHE_BUDGET (256u << 20)      // GPU bytes kept resident before eviction
+#define TILE_CACHE_UPLOAD_BYTES (4u << 20)  // GPU bytes uploaded per UpdateTileCache call, one tile at least
+
+//------------------------------------------------------------------------------------
+// TileCache - streamed fill and outline meshes for layers too large to keep resident
+//
+// The layer extent is cut into a grid of tiles. Lines and polygons are clipped to every
+// cell they overlap (see RectClip.h), so a tile holds exactly its cell and large features
+// no longer stretch a tile across its neighbours; points belong to the cell they lie in.
+// Opening the cache keeps only the feature boxes and their spatial index, in the target
+// units of the cache transform. Every tile that becomes visible is one job on the
+// JobSystem running the pipeline read -> simplify -> clip -> triangulate -> pack:
+// features come through the index and SHPReadObject on the worker's own handle, are
+// simplified to the cache tolerance (before clipping, so both sides of a cell border see
+// the same simplified outline), clipped, triangulated and quantized to 16 bits over the
+// tile extent (see Quantize.h).
+// The main thread uploads finished tiles within a per-frame byte budget and evicts the
+// least recently used ones once the resident GPU bytes exceed the cache budget.
+//
+// Fill tiles exist for polygon layers only. A cache opened with outlines has a set of
+// outline tiles after them, one per cell, holding the unsimplified lines of the cell as
+// line meshes (see LineMesh.h); a line layer has those alone. Polygon rings are clipped
+// as lines, so cell borders add no outline. Outline tiles are requested only while the
+// caller asks for them and share the states, LRU order and budget of the fill tiles.
+//------------------------------------------------------------------------------------
+typedef enum {
+    TILE_EMPTY = 0,         // Nothing resident
+    TILE_QUEUED,            // Waiting for or being built by a loader
+    TILE_LOADED             // Chunks uploaded and drawable
+} TileState;
+
+typedef struct Tile {
+    Bounds bounds;                      // Extent of the clipped features, inside the cell
+    int state;                          // TileState
+    std::vector<QuantizedMesh> chunks;
+    LineMesh outline;                   // Outline tiles only
+    size_t bytes;                       // GPU bytes held by the chunks and outline
+    unsigned int lastUsed;              // Frame the tile was last visible
+    std::list<int>::iterator lruPos;    // Position in TileCache.lru while loaded
+} Tile;
+
+typedef struct TileResult {
+    int tile;
+    std::vector<QuantizedChunkData> chunks;
+    LineMeshData outline;
+} TileResult;
+
+typedef struct TileCache {
+    std::string fileName;
+    int shapeType;
+    Bounds bounds;                      // Layer extent, the grid covers it
+    int tilesX;
+    int tilesY;
+    double tileWidth;
+    double tileHeight;
+    int cellCount;                      // tilesX*tilesY
+    bool fills;                         // Fill tiles exist, tile = cell
+    bool outlines;                      // Outline tiles exist, tile = outlineFirst + cell
+    int outlineFirst;                   // cellCount after fill tiles, else 0
+    std::vector<Bounds> featureBounds;
+    SpatialIndex featureIndex;
+    SpatialIndex tileIndex;             // Over Tile.bounds, answers visibility
+    std::vector<Tile> tiles;
+    std::list<int> lru;                 // Loaded tiles, most recently used first
+    std::vector<int> visible;           // Tiles touched by the last UpdateTileCache
+    std::vector<TileResult> uploads;    // Finished tiles waiting for the main thread
+    std::vector<int> queued;            // Tiles in TILE_QUEUED state
+    QuantizedShader shader;
+    LineShader lineShader;              // Loaded with outlines only
+    size_t budget;
+    size_t bytes;
+    unsigned int frame;
+    double tolerance;                   // Simplification applied before triangulation, 0 for none
+    FillMethod fillMethod;              // Triangulation of the clipped polygons
+    CoordinateTransform transform;      // Applied to every object read from the file
+
+    // Shared with the jobs
+    JobSystem *jobs;
+    JobCounter inFlight;
+    std::vector<SHPHandle> handles;     // One per pool worker plus one for other threads, opened by their user
+    std::mutex mutex;
+    std::vector<char> requested;        // Tile jobs submitted and not started, guarded by mutex
+    std::vector<TileResult> results;    // Guarded by mutex
+} TileCache;
+
+inline int TileCacheColumn(const TileCache &cache, double x)
+{
+    int tx = (cache.tileWidth > 0.0) ? (int)((x - cache.bounds.minX)/cache.tileWidth) : 0;
+    return (tx < 0) ? 0 : (tx >= cache.tilesX) ? cache.tilesX - 1 : tx;
+}
+
+inline int TileCacheRow(const TileCache &cache, double y)
+{
+    int ty = (cache.tileHeight > 0.0) ? (int)((y - cache.bounds.minY)/cache.tileHeight) : 0;
+    return (ty < 0) ? 0 : (ty >= cache.tilesY) ? cache.tilesY - 1 : ty;
+}
+
+// Tile owning a feature, from the centre of its bounding box
+inline int TileCacheFeatureTile(const TileCache &cache, const Bounds &b)
+{
+    return TileCacheRow(cache, 0.5*(b.minY + b.maxY))*cache.tilesX + TileCacheColumn(cache, 0.5*(b.minX + b.maxX));
+}
+
+inline bool TileCacheIsOutline(const TileCache &cache, int tile)
+{
+    return cache.outlines && tile >= cache.outlineFirst;
+}
+
+// Grid cell of a fill or outline tile, features are looked up and clipped with this
+// rectangle. The last row and column end exactly on the layer extent.
+inline Bounds TileCacheCell(const TileCache &cache, int tile)
+{
+    int tx = tile%cache.cellCount%cache.tilesX;
+    int ty = tile%cache.cellCount/cache.tilesX;
+    Bounds cell = { cache.bounds.minX + tx*cache.tileWidth, cache.bounds.minY + ty*cache.tileHeight,
+                    (tx + 1 == cache.tilesX) ? cache.bounds.maxX : cache.bounds.minX + (tx + 1)*cache.tileWidth,
+                    (ty + 1 == cache.tilesY) ? cache.bounds.maxY : cache.bounds.minY + (ty + 1)*cache.tileHeight };
+    return cell;
+}
+
+// Read, simplify, clip, triangulate and quantize one fill tile, or read, clip and widen
+// one outline tile; runs on a pool worker
+inline void BuildTileChunks(const TileCache &cache, SHPHandle hSHP, int tile, TileResult *result)
+{
+    std::vector<int> candidates;
+    Bounds cell = TileCacheCell(cache, tile);
+    SpatialIndexSearch(cache.featureIndex, cell, &candidates);
+    bool points = IsPointType(cache.shapeType);
+
+    Layer layer;
+    layer.shapeType = cache.shapeType;
+    layer.featureCount = 0;
+    layer.bounds = EmptyBounds();
+
+    for (int i = 0; i < (int)candidates.size(); i++)
+    {
+        int f = candidates[i];
+        if (points && TileCacheFeatureTile(cache, cache.featureBounds[f]) != tile) continue;
+
+        SHPObject *obj = SHPReadObject(hSHP, f);
+        TransformObject(cache.transform, obj);
+        LayerAppendObject(&layer, obj);
+        if (obj != NULL) SHPDestroyObject(obj);
+    }
+
+    if (layer.featureCount == 0) return;
+    if (TileCacheIsOutline(cache, tile))
+    {
+        if (IsPolygonType(layer.shapeType)) layer.shapeType = SHPT_ARC;
+        BuildLineChunks(ClipLayerToRect(layer, cell), LINE_JOIN_ROUND, &result->outline);
+        return;
+    }
+    if (cache.tolerance > 0.0) layer = SimplifyLayer(layer, cache.tolerance);
+    if (!points) layer = ClipLayerToRect(layer, cell);
+
+    // Simplification keeps a subset of the vertices and clipping stays in the cell, so
+    // the tile bounds still hold them all
+    const Bounds &bounds = cache.tiles[tile].bounds;
+    LayerFill fill = BuildLayerFill(layer, cache.fillMethod);
+    std::vector<MeshChunkData> floats;
+    BuildFillChunks(layer, fill, bounds.minX, bounds.minY, &floats);
+    for (int i = 0; i < (int)floats.size(); i++) result->chunks.push_back(QuantizeChunk(floats[i], bounds));
+}
+
+inline void TileCacheJob(TileCache *cache, int tile)
+{
+    // Requests dropped before the job started are skipped
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if (!cache->requested[tile]) return;
+        cache->requested[tile] = 0;
+    }
+
+    int slot = JobWorkerSlot();
+    SHPHandle &hSHP = cache->handles[(slot >= 0) ? slot : cache->handles.size() - 1];
+    if (hSHP == NULL) hSHP = SHPOpen(cache->fileName.c_str(), "rb");
+
+    TileResult result;
+    result.tile = tile;
+    if (hSHP != NULL) BuildTileChunks(*cache, hSHP, tile, &result);
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->results.push_back(result);
+}
+
+// Open a shapefile for streaming, tiles are reprojected with 'transform', built on 'jobs',
+// simplified to 'tolerance' (map units, 0 keeps every vertex) and filled with 'fillMethod';
+// 'outlines' adds the outline tiles of a line or polygon layer. Only polygon layers get fill
+// tiles, so a point layer has nothing to stream. Needs an open window for the shaders,
+// returns NULL on failure.
+inline TileCache *LoadTileCache(const char *fileName, size_t budget, double tolerance, const CoordinateTransform &transform, JobSystem *jobs,
+                                FillMethod fillMethod = FILL_EARCUT, bool outlines = false)
+{
+    SHPHandle hSHP = SHPOpen(fileName, "rb");
+    if (hSHP == NULL) return NULL;
+
+    TileCache *cache = new TileCache();
+    cache->fileName = fileName;
+    cache->bounds = EmptyBounds();
+    cache->budget = budget;
+    cache->bytes = 0;
+    cache->frame = 0;
+    cache->tolerance = tolerance;
+    cache->fillMethod = fillMethod;
+    cache->transform = transform;
+    cache->jobs = jobs;
+    cache->inFlight = 0;
+    cache->handles.assign(JobSystemThreadCount(*jobs) + 1, (SHPHandle)NULL);
+
+    // Only the boxes stay resident, the geometry is read again per tile
+    int nEntities = 0, nShapeType = 0;
+    SHPGetInfo(hSHP, &nEntities, &nShapeType, NULL, NULL);
+    cache->shapeType = nShapeType;
+    cache->featureBounds.reserve(nEntities);
+    for (int i = 0; i < nEntities; i++)
+    {
+        Bounds b = EmptyBounds();
+        SHPObject *obj = SHPReadObject(hSHP, i);
+        if (obj != NULL)
+        {
+            TransformObject(transform, obj);
+            for (int v = 0; v < obj->nVertices; v++) BoundsExtend(&b, obj->padfX[v], obj->padfY[v]);
+            SHPDestroyObject(obj);
+        }
+        cache->featureBounds.push_back(b);
+        if (!BoundsIsEmpty(b)) BoundsMerge(&cache->bounds, b);
+    }
+    SHPClose(hSHP);
+
+    int side = (int)ceil(sqrt((double)nEntities/TILE_CACHE_FEATURES));
+    side = (side < 1) ? 1 : (side > TILE_CACHE_MAX_GRID) ? TILE_CACHE_MAX_GRID : side;
+    cache->tilesX = side;
+    cache->tilesY = side;
+    cache->tileWidth = BoundsIsEmpty(cache->bounds) ? 0.0 : (cache->bounds.maxX - cache->bounds.minX)/side;
+    cache->tileHeight = BoundsIsEmpty(cache->bounds) ? 0.0 : (cache->bounds.maxY - cache->bounds.minY)/side;
+    cache->cellCount = side*side;
+    cache->fills = IsPolygonType(nShapeType);
+    cache->outlines = outlines && !IsPointType(nShapeType);
+    cache->outlineFirst = cache->fills ? cache->cellCount : 0;
+
+    cache->tiles.resize((cache->fills ? cache->cellCount : 0) + (cache->outlines ? cache->cellCount : 0));
+    cache->requested.assign(cache->tiles.size(), 0);
+    for (int t = 0; t < (int)cache->tiles.size(); t++)
+    {
+        cache->tiles[t].bounds = EmptyBounds();
+        cache->tiles[t].state = TILE_EMPTY;
+        cache->tiles[t].bytes = 0;
+        cache->tiles[t].lastUsed = 0;
+    }
+
+    // A tile spans the part of each overlapping feature box inside its cell
+    std::vector<Bounds> tileBounds(cache->cellCount, EmptyBounds());
+    for (int f = 0; f < nEntities; f++)
+    {
+        const Bounds &b = cache->featureBounds[f];
+        if (BoundsIsEmpty(b)) continue;
+        if (IsPointType(nShapeType))
+        {
+            BoundsMerge(&tileBounds[TileCacheFeatureTile(*cache, b)], b);
+            continue;
+        }
+        for (int ty = TileCacheRow(*cache, b.minY); ty <= TileCacheRow(*cache, b.maxY); ty++)
+        {
+            for (int tx = TileCacheColumn(*cache, b.minX); tx <= TileCacheColumn(*cache, b.maxX); tx++)
+            {
+                int t = ty*side + tx;
+                Bounds part = BoundsIntersection(b, TileCacheCell(*cache, t));
+                if (!BoundsIsEmpty(part)) BoundsMerge(&tileBounds[t], part);
+            }
+        }
+    }
+    for (int t = 0; t < (int)cache->tiles.size(); t++) cache->tiles[t].bounds = tileBounds[t%cache->cellCount];
+
+    cache->featureIndex = BuildSpatialIndex(cache->featureBounds, SPATIAL_INDEX_NODE_SIZE);
+    cache->tileIndex = BuildSpatialIndex(tileBounds, SPATIAL_INDEX_NODE_SIZE);
+    cache->shader = LoadQuantizedShader();
+    if (cache->outlines) cache->lineShader = LoadLineShader();
+
+    return cache;
+}
+
+inline void TileCacheEvict(TileCache *cache, int tile)
+{
+    Tile &t = cache->tiles[tile];
+    for (int i = 0; i < (int)t.chunks.size(); i++) UnloadQuantizedMesh(t.chunks[i]);
+    t.chunks.clear();
+    UnloadLineMesh(&t.outline);
+    cache->bytes -= t.bytes;
+    t.bytes = 0;
+    t.state = TILE_EMPTY;
+    cache->lru.erase(t.lruPos);
+}
+
+// Per frame on the main thread: request the tiles overlapping 'view', with their outline
+// tiles when 'outlines' is set, drop requests that went out of view, upload finished tiles
+// and evict down to the budget. Returns the number of tiles uploaded, anything caching the
+// drawn result is stale when it is not 0.
+inline int UpdateTileCache(TileCache *cache, const Bounds &view, bool outlines = false)
+{
+    cache->frame++;
+    SpatialIndexSearch(cache->tileIndex, view, &cache->visible);
+    int cells = (int)cache->visible.size();
+    for (int i = 0; cache->outlines && outlines && i < cells; i++) cache->visible.push_back(cache->outlineFirst + cache->visible[i]);
+    if (!cache->fills) cache->visible.erase(cache->visible.begin(), cache->visible.begin() + cells);
+
+    std::vector<int> submit;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+
+        for (int i = 0; i < (int)cache->visible.size(); i++)
+        {
+            int t = cache->visible[i];
+            Tile &tile = cache->tiles[t];
+            tile.lastUsed = cache->frame;
+            if (tile.state == TILE_EMPTY)
+            {
+                tile.state = TILE_QUEUED;
+                cache->requested[t] = 1;
+                cache->queued.push_back(t);
+                submit.push_back(t);
+            }
+            else if (tile.state == TILE_LOADED) cache->lru.splice(cache->lru.begin(), cache->lru, tile.lruPos);
+        }
+
+        // Tiles that left the view before their job started are dropped, started ones finish
+        std::vector<int> queued;
+        for (int i = 0; i < (int)cache->queued.size(); i++)
+        {
+            int t = cache->queued[i];
+            if (cache->tiles[t].state != TILE_QUEUED) continue;
+            if (cache->tiles[t].lastUsed != cache->frame && cache->requested[t])
+            {
+                cache->requested[t] = 0;
+                cache->tiles[t].state = TILE_EMPTY;
+            }
+            else queued.push_back(t);
+        }
+        cache->queued.swap(queued);
+
+        cache->uploads.insert(cache->uploads.end(), cache->results.begin(), cache->results.end());
+        cache->results.clear();
+    }
+
+    for (int i = 0; i < (int)submit.size(); i++)
+    {
+        int t = submit[i];
+        SubmitJob(cache->jobs, [cache, t]() { TileCacheJob(cache, t); }, &cache->inFlight);
+    }
+
+    // Upload within the frame budget so a burst of finished tiles cannot cause a hitch
+    int uploaded = 0;
+    size_t uploadedBytes = 0;
+    while (!cache->uploads.empty() && (uploaded == 0 || uploadedBytes < TILE_CACHE_UPLOAD_BYTES))
+    {
+        TileResult &result = cache->uploads.back();
+        Tile &tile = cache->tiles[result.tile];
+
+        // A result for a dropped or already served request is stale
+        if (tile.state == TILE_QUEUED)
+        {
+            for (int i = 0; i < (int)result.chunks.size(); i++)
+            {
+                tile.chunks.push_back(UploadQuantizedChunk(result.chunks[i]));
+                tile.bytes += QuantizedChunkBytes(result.chunks[i]);
+            }
+            tile.outline = UploadLineMesh(result.outline);
+            tile.bytes += LineMeshDataBytes(result.outline);
+            tile.state = TILE_LOADED;
+            cache->bytes += tile.bytes;
+            cache->lru.push_front(result.tile);
+            tile.lruPos = cache->lru.begin();
+            uploadedBytes += tile.bytes;
+            uploaded++;
+        }
+
+        cache->uploads.pop_back();
+    }
+
+    // Tiles visible this frame are never evicted, the budget may be exceeded while they are
+    while (cache->bytes > cache->budget && !cache->lru.empty())
+    {
+        int tile = cache->lru.back();
+        if (cache->tiles[tile].lastUsed == cache->frame) break;
+        TileCacheEvict(cache, tile);
+    }
+
+    return uploaded;
+}
+
+// Draw the loaded fill tiles from the last UpdateTileCache, each relative to the frame origin
+inline void DrawTileCache(const TileCache &cache, const RenderFrame &frame, Color color)
+{
+    for (int i = 0; i < (int)cache.visible.size(); i++)
+    {
+        const Tile &tile = cache.tiles[cache.visible[i]];
+        if (TileCacheIsOutline(cache, cache.visible[i]) || tile.state != TILE_LOADED) continue;
+        DrawQuantizedChunks(tile.chunks, cache.shader, tile.bounds, frame, color);
+    }
+}
+
+// Draw the loaded outline tiles from the last UpdateTileCache, see DrawLineMesh for 'view'
+// and 'halfWidth'
+inline void DrawTileCacheOutlines(const TileCache &cache, const RenderFrame &frame, const Bounds &view, float halfWidth, Color color)
+{
+    for (int i = 0; i < (int)cache.visible.size(); i++)
+    {
+        const Tile &tile = cache.tiles[cache.visible[i]];
+        if (!TileCacheIsOutline(cache, cache.visible[i]) || tile.state != TILE_LOADED) continue;
+        DrawLineMesh(tile.outline, cache.lineShader, frame, view, halfWidth, color);
+    }
+}
+
+inline int TileCacheLoadedCount(const TileCache &cache)
+{
+    return (int)cache.lru.size();
+}
+
+// Cancel pending tile jobs, wait for running ones and release every resident tile
+inline void UnloadTileCache(TileCache *cache)
+{
+    if (cache == NULL) return;
+
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->requested.assign(cache->requested.size(), 0);
+    }
+    WaitJobCounter(cache->jobs, &cache->inFlight);
+    for (int i = 0; i < (int)cache->handles.size(); i++)
+    {
+        if (cache->handles[i] != NULL) SHPClose(cache->handles[i]);
+    }
+
+    while (!cache->lru.empty()) TileCacheEvict(cache, cache->lru.back());
+    UnloadQuantizedShader(cache->shader);
+    if (cache->outlines) UnloadLineShader(cache->lineShader);
+    delete cache;
+}
+
+#endif // VECTORMAP_TILE_CACHE_H
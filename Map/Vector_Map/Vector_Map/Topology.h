@@ -0,0 +1,360 @@
+#ifndef VECTORMAP_TOPOLOGY_H
+#define VECTORMAP_TOPOLOGY_H
+
+#include "Layer.h"
+#include "Simplify.h"
+#include "JobSystem.h"
+#include <vector>
+#include <unordered_map>
+#include <string.h>
+
+//------------------------------------------------------------------------------------
+// Topology - polygon rings as shared arcs, TopoJSON style
+//
+// Vertices are hashed on their exact coordinates, so neighbouring polygons that store a
+// common border with the same points find each other. A vertex is a junction when its
+// occurrences disagree on their neighbours: a point where three or more rings meet, or
+// where two rings stop sharing. Rings are cut at junctions into arcs, and an arc met a
+// second time (forward or walked backwards) is stored once and referenced, ~a meaning
+// arc a reversed. A ring without junctions is a single closed arc starting at its lowest
+// vertex id, so a hole and the island filling it share it too.
+//
+// Borders drawn from the arcs appear once, and arcs simplified on their own keep both
+// sides of a border identical: simplified neighbours still tile without gaps or slivers,
+// unless a tolerance near the feature size makes Douglas-Peucker cross two arcs.
+// Borders whose vertices do not match exactly (one side has an extra point) stay apart.
+//------------------------------------------------------------------------------------
+typedef struct Topology {
+    int shapeType;
+    int featureCount;
+    Bounds bounds;
+    std::vector<Bounds> featureBounds;
+    std::vector<int> featurePart;       // featureCount + 1 offsets into ringArc
+    std::vector<int> ringArc;           // ringCount + 1 offsets into arcs
+    std::vector<int> arcs;              // Arc references of the rings, ~a walks arc a backwards
+    std::vector<int> arcStart;          // arcCount + 1 offsets into x/y
+    std::vector<double> x;              // Arc vertices, junctions are repeated at both arcs' ends
+    std::vector<double> y;
+    std::vector<int> arcFeatures;       // Two per arc, the features on its sides, -1 for the outside
+} Topology;
+
+typedef struct TopologyVertexKey {
+    double x, y;
+    bool operator==(const TopologyVertexKey &other) const { return x == other.x && y == other.y; }
+} TopologyVertexKey;
+
+typedef struct TopologyVertexHash {
+    size_t operator()(const TopologyVertexKey &key) const
+    {
+        unsigned long long bx, by;
+        memcpy(&bx, &key.x, sizeof(bx));
+        memcpy(&by, &key.y, sizeof(by));
+        return (size_t)(bx*0x9E3779B97F4A7C15ull ^ (by + 0x632BE59BD9B4E019ull + (bx << 6) + (bx >> 2)));
+    }
+} TopologyVertexHash;
+
+inline int TopologyArcCount(const Topology &topology)
+{
+    return (int)topology.arcStart.size() - 1;
+}
+
+inline int TopologyRingCount(const Topology &topology)
+{
+    return (int)topology.ringArc.size() - 1;
+}
+
+// Key of the directed step a -> b between two vertex ids
+inline unsigned long long TopologyStepKey(int a, int b)
+{
+    return ((unsigned long long)(unsigned int)a << 32) | (unsigned int)b;
+}
+
+// Arcs of every ring of a polygon layer. Closing vertices and repeated points are dropped
+// while hashing, rings keep their numbering but may start at another vertex.
+inline Topology BuildTopology(const Layer &layer)
+{
+    Topology topology;
+    topology.shapeType = layer.shapeType;
+    topology.featureCount = layer.featureCount;
+    topology.bounds = layer.bounds;
+    topology.featureBounds = layer.featureBounds;
+    topology.featurePart = layer.featurePart;
+    topology.ringArc.push_back(0);
+    topology.arcStart.push_back(0);
+    int ringCount = LayerPartCount(layer);
+
+    // Vertex ids per ring, open; +0.0 and -0.0 hash alike
+    std::unordered_map<TopologyVertexKey, int, TopologyVertexHash> vertexIds;
+    std::vector<double> vx, vy;
+    std::vector<int> ringVertex, ringOffset(1, 0);
+    vertexIds.reserve(layer.x.size());
+    for (int p = 0; p < ringCount; p++)
+    {
+        int first = (int)ringVertex.size();
+        for (int v = layer.partStart[p]; v < layer.partStart[p + 1]; v++)
+        {
+            TopologyVertexKey key = { layer.x[v] + 0.0, layer.y[v] + 0.0 };
+            std::pair<std::unordered_map<TopologyVertexKey, int, TopologyVertexHash>::iterator, bool> it = vertexIds.insert(std::make_pair(key, (int)vx.size()));
+            if (it.second)
+            {
+                vx.push_back(key.x);
+                vy.push_back(key.y);
+            }
+            int id = it.first->second;
+            if ((int)ringVertex.size() > first && ringVertex.back() == id) continue;
+            ringVertex.push_back(id);
+        }
+        while ((int)ringVertex.size() > first + 1 && ringVertex.back() == ringVertex[first]) ringVertex.pop_back();
+        ringOffset.push_back((int)ringVertex.size());
+    }
+
+    // Junctions: the unordered neighbour pair of a vertex changes between occurrences
+    int vertexCount = (int)vx.size();
+    std::vector<int> neighbourA(vertexCount, -1), neighbourB(vertexCount, -1);
+    std::vector<char> junction(vertexCount, 0);
+    for (int r = 0; r < ringCount; r++)
+    {
+        int first = ringOffset[r], n = ringOffset[r + 1] - first;
+        for (int i = 0; i < n; i++)
+        {
+            int v = ringVertex[first + i];
+            int a = ringVertex[first + (i + n - 1)%n], b = ringVertex[first + (i + 1)%n];
+            if (a > b) std::swap(a, b);
+            if (neighbourA[v] < 0)
+            {
+                neighbourA[v] = a;
+                neighbourB[v] = b;
+            }
+            else if (neighbourA[v] != a || neighbourB[v] != b) junction[v] = 1;
+        }
+    }
+
+    // Cut every ring at its junctions, each step key names the one arc that leaves a
+    // vertex towards a given neighbour
+    std::unordered_map<unsigned long long, int> arcByStep;
+    std::vector<int> path;
+    for (int r = 0; r < ringCount; r++)
+    {
+        int first = ringOffset[r], n = ringOffset[r + 1] - first;
+        const int *ring = ringVertex.data() + first;
+        int start = -1;
+        for (int i = 0; i < n && start < 0; i++) if (junction[ring[i]]) start = i;
+        if (start < 0)
+        {
+            start = 0;
+            for (int i = 1; i < n; i++) if (ring[i] < ring[start]) start = i;
+        }
+
+        for (int i = 0; i < n; )
+        {
+            path.clear();
+            path.push_back(ring[(start + i)%n]);
+            do
+            {
+                i++;
+                path.push_back(ring[(start + i)%n]);
+            } while (i < n && !junction[path.back()]);
+
+            int count = (int)path.size(), arc;
+            std::unordered_map<unsigned long long, int>::iterator found = (count > 1) ? arcByStep.find(TopologyStepKey(path[0], path[1])) : arcByStep.end();
+            if (found != arcByStep.end()) arc = found->second;
+            else
+            {
+                arc = TopologyArcCount(topology);
+                for (int k = 0; k < count; k++)
+                {
+                    topology.x.push_back(vx[path[k]]);
+                    topology.y.push_back(vy[path[k]]);
+                }
+                topology.arcStart.push_back((int)topology.x.size());
+                topology.arcFeatures.push_back(-1);
+                topology.arcFeatures.push_back(-1);
+                if (count > 1)
+                {
+                    arcByStep[TopologyStepKey(path[0], path[1])] = arc;
+                    arcByStep.insert(std::make_pair(TopologyStepKey(path[count - 1], path[count - 2]), ~arc));
+                }
+            }
+            topology.arcs.push_back(arc);
+        }
+        topology.ringArc.push_back((int)topology.arcs.size());
+    }
+
+    // Sides of each arc, found through the ring to feature mapping
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        for (int r = layer.featurePart[f]; r < layer.featurePart[f + 1]; r++)
+        {
+            for (int k = topology.ringArc[r]; k < topology.ringArc[r + 1]; k++)
+            {
+                int arc = (topology.arcs[k] < 0) ? ~topology.arcs[k] : topology.arcs[k];
+                int *sides = &topology.arcFeatures[2*arc];
+                sides[(sides[0] < 0) ? 0 : 1] = f;
+            }
+        }
+    }
+
+    return topology;
+}
+
+// Polygon layer assembled from the arcs, with the topology's feature and ring numbering.
+// Bounds are those of the topology, columns are not carried.
+inline Layer TopologyLayer(const Topology &topology)
+{
+    Layer layer;
+    layer.shapeType = topology.shapeType;
+    layer.featureCount = topology.featureCount;
+    layer.bounds = topology.bounds;
+    layer.featureBounds = topology.featureBounds;
+    layer.featurePart = topology.featurePart;
+    layer.partStart.reserve(topology.ringArc.size());
+    layer.partStart.push_back(0);
+
+    for (int r = 0; r < TopologyRingCount(topology); r++)
+    {
+        for (int k = topology.ringArc[r]; k < topology.ringArc[r + 1]; k++)
+        {
+            int ref = topology.arcs[k], arc = (ref < 0) ? ~ref : ref;
+            int first = topology.arcStart[arc], last = topology.arcStart[arc + 1] - 1;
+
+            // Arcs after the first skip the vertex they share with the previous one
+            int skip = (k == topology.ringArc[r]) ? 0 : 1;
+            for (int i = skip; i <= last - first; i++)
+            {
+                int v = (ref < 0) ? last - i : first + i;
+                layer.x.push_back(topology.x[v]);
+                layer.y.push_back(topology.y[v]);
+            }
+        }
+        layer.partStart.push_back((int)layer.x.size());
+    }
+
+    return layer;
+}
+
+// Line layer with one feature per arc: every border once
+inline Layer TopologyArcLayer(const Topology &topology)
+{
+    Layer layer;
+    layer.shapeType = SHPT_ARC;
+    layer.featureCount = TopologyArcCount(topology);
+    layer.bounds = EmptyBounds();
+    layer.x = topology.x;
+    layer.y = topology.y;
+    layer.partStart = topology.arcStart;
+    layer.featurePart.resize(layer.featureCount + 1);
+    layer.featureBounds.resize(layer.featureCount);
+
+    for (int a = 0; a < layer.featureCount; a++)
+    {
+        layer.featurePart[a] = a;
+        Bounds b = EmptyBounds();
+        for (int v = topology.arcStart[a]; v < topology.arcStart[a + 1]; v++) BoundsExtend(&b, topology.x[v], topology.y[v]);
+        layer.featureBounds[a] = b;
+        if (!BoundsIsEmpty(b)) BoundsMerge(&layer.bounds, b);
+    }
+    layer.featurePart[layer.featureCount] = layer.featureCount;
+
+    return layer;
+}
+
+// Copy of the topology with every arc simplified to 'tolerance'. Arc ends are junctions
+// and stay; closed arcs are simplified as rings. An arc of a ring made of one or two arcs
+// keeps at least its farthest vertex, so such rings do not collapse to a segment.
+inline Topology SimplifyTopology(const Topology &topology, double tolerance)
+{
+    Topology simple = topology;
+    simple.x.clear();
+    simple.y.clear();
+    simple.arcStart.assign(1, 0);
+
+    int arcCount = TopologyArcCount(topology);
+    std::vector<char> keepInterior(arcCount, 0);
+    for (int r = 0; r < TopologyRingCount(topology); r++)
+    {
+        if (topology.ringArc[r + 1] - topology.ringArc[r] > 2) continue;
+        for (int k = topology.ringArc[r]; k < topology.ringArc[r + 1]; k++)
+        {
+            int ref = topology.arcs[k];
+            keepInterior[(ref < 0) ? ~ref : ref] = 1;
+        }
+    }
+
+    std::vector<char> keep;
+    for (int a = 0; a < arcCount; a++)
+    {
+        int first = topology.arcStart[a], count = topology.arcStart[a + 1] - first;
+        const double *xs = topology.x.data() + first, *ys = topology.y.data() + first;
+        bool closed = count > 3 && xs[0] == xs[count - 1] && ys[0] == ys[count - 1];
+
+        if (closed || count <= 2 || tolerance <= 0.0) SimplifyPart(xs, ys, count, closed, tolerance, &simple.x, &simple.y);
+        else
+        {
+            keep.assign(count, 0);
+            keep[0] = 1;
+            keep[count - 1] = 1;
+            DouglasPeucker(xs, ys, 0, count - 1, tolerance*tolerance, &keep);
+
+            int kept = 0;
+            for (int i = 1; i < count - 1; i++) kept += keep[i];
+            if (kept == 0 && keepInterior[a])
+            {
+                int farthest = 1;
+                double farthestSq = -1.0;
+                for (int i = 1; i < count - 1; i++)
+                {
+                    double d = PointSegmentDistanceSq(xs[i], ys[i], xs[0], ys[0], xs[count - 1], ys[count - 1]);
+                    if (d > farthestSq)
+                    {
+                        farthest = i;
+                        farthestSq = d;
+                    }
+                }
+                keep[farthest] = 1;
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                if (!keep[i]) continue;
+                simple.x.push_back(xs[i]);
+                simple.y.push_back(ys[i]);
+            }
+        }
+        simple.arcStart.push_back((int)simple.x.size());
+    }
+
+    return simple;
+}
+
+// Gap-free LOD pyramid of a polygon layer, levels as in BuildLayerLod. borders receives
+// the arcs of every level, level 0 included, to draw each shared border once.
+inline LayerLod BuildTopologyLod(const Topology &topology, double baseTolerance, int levelCount, JobSystem *jobs, std::vector<Layer> *borders)
+{
+    LayerLod lod;
+    lod.tolerance.push_back(0.0);
+
+    double tolerance = baseTolerance;
+    for (int i = 1; i < levelCount; i++)
+    {
+        lod.tolerance.push_back(tolerance);
+        tolerance *= LOD_LEVEL_STEP;
+    }
+
+    lod.levels.resize(lod.tolerance.size() - 1);
+    borders->assign(lod.tolerance.size(), Layer());
+    (*borders)[0] = TopologyArcLayer(topology);
+    auto build = [&](int first, int last) {
+        for (int i = first; i < last; i++)
+        {
+            Topology simple = SimplifyTopology(topology, lod.tolerance[i + 1]);
+            lod.levels[i] = TopologyLayer(simple);
+            (*borders)[i + 1] = TopologyArcLayer(simple);
+        }
+    };
+    if (jobs != NULL) ParallelFor(jobs, (int)lod.levels.size(), 1, build);
+    else build(0, (int)lod.levels.size());
+
+    return lod;
+}
+
+#endif // VECTORMAP_TOPOLOGY_H
@@ -0,0 +1,755 @@
+#ifndef VECTORMAP_TRIANGULATOR_H
+#define VECTORMAP_TRIANGULATOR_H
+
+#include "Layer.h"
+#include "Geometry.h"
+#include "Delaunay.h"
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#define EARCUT_HASH_THRESHOLD 80    // Rings above this many vertices use z-order hashed ear tests
+
+//------------------------------------------------------------------------------------
+// Triangulator - ear clipping with hole bridging (port of mapbox earcut)
+//
+// Rings are turned into a circular doubly linked list, holes are bridged into the outer
+// ring at their leftmost vertex, then ears are clipped. Large rings keep a second list
+// sorted along a z-order curve so the ear test only looks at nearby vertices. Emitted
+// indices refer to the caller's coordinate arrays.
+//------------------------------------------------------------------------------------
+typedef struct RingRange {
+    int start;
+    int end;                        // One past the last vertex
+} RingRange;
+
+typedef struct EarcutNode {
+    int i;                          // Vertex index in the source arrays
+    double x;
+    double y;
+    EarcutNode *prev;
+    EarcutNode *next;
+    int z;                          // z-order curve value
+    EarcutNode *prevZ;
+    EarcutNode *nextZ;
+    bool steiner;
+} EarcutNode;
+
+typedef struct Earcut {
+    std::deque<EarcutNode> nodes;   // Stable storage, bridges and splits append to it
+    std::vector<unsigned int> *triangles;
+    double minX;
+    double minY;
+    double invSize;
+} Earcut;
+
+inline double EarcutArea(const EarcutNode *p, const EarcutNode *q, const EarcutNode *r)
+{
+    return (q->y - p->y)*(r->x - q->x) - (q->x - p->x)*(r->y - q->y);
+}
+
+inline bool EarcutEquals(const EarcutNode *a, const EarcutNode *b)
+{
+    return a->x == b->x && a->y == b->y;
+}
+
+inline bool EarcutPointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+{
+    return (cx - px)*(ay - py) >= (ax - px)*(cy - py) &&
+           (ax - px)*(by - py) >= (bx - px)*(ay - py) &&
+           (bx - px)*(cy - py) >= (cx - px)*(by - py);
+}
+
+inline int EarcutSign(double v)
+{
+    return (v > 0) - (v < 0);
+}
+
+inline bool EarcutOnSegment(const EarcutNode *p, const EarcutNode *q, const EarcutNode *r)
+{
+    return q->x <= fmax(p->x, r->x) && q->x >= fmin(p->x, r->x) && q->y <= fmax(p->y, r->y) && q->y >= fmin(p->y, r->y);
+}
+
+inline bool EarcutIntersects(const EarcutNode *p1, const EarcutNode *q1, const EarcutNode *p2, const EarcutNode *q2)
+{
+    int o1 = EarcutSign(EarcutArea(p1, q1, p2));
+    int o2 = EarcutSign(EarcutArea(p1, q1, q2));
+    int o3 = EarcutSign(EarcutArea(p2, q2, p1));
+    int o4 = EarcutSign(EarcutArea(p2, q2, q1));
+
+    if (o1 != o2 && o3 != o4) return true;
+    if (o1 == 0 && EarcutOnSegment(p1, p2, q1)) return true;
+    if (o2 == 0 && EarcutOnSegment(p1, q2, q1)) return true;
+    if (o3 == 0 && EarcutOnSegment(p2, p1, q2)) return true;
+    if (o4 == 0 && EarcutOnSegment(p2, q1, q2)) return true;
+    return false;
+}
+
+inline EarcutNode *EarcutInsertNode(Earcut *ec, int i, double x, double y, EarcutNode *last)
+{
+    EarcutNode node = { i, x, y, NULL, NULL, 0, NULL, NULL, false };
+    ec->nodes.push_back(node);
+    EarcutNode *p = &ec->nodes.back();
+
+    if (last == NULL)
+    {
+        p->prev = p;
+        p->next = p;
+    }
+    else
+    {
+        p->next = last->next;
+        p->prev = last;
+        last->next->prev = p;
+        last->next = p;
+    }
+    return p;
+}
+
+inline void EarcutRemoveNode(EarcutNode *p)
+{
+    p->next->prev = p->prev;
+    p->prev->next = p->next;
+    if (p->prevZ) p->prevZ->nextZ = p->nextZ;
+    if (p->nextZ) p->nextZ->prevZ = p->prevZ;
+}
+
+// Signed area in earcut's convention of one ring of the source arrays
+inline double EarcutSignedArea(const double *x, const double *y, int start, int end)
+{
+    double sum = 0.0;
+    for (int i = start, j = end - 1; i < end; j = i++) sum += (x[j] - x[i])*(y[i] + y[j]);
+    return sum;
+}
+
+// Circular list of one ring in the requested winding, a closing duplicate vertex is dropped
+inline EarcutNode *EarcutLinkedList(Earcut *ec, const double *x, const double *y, int start, int end, bool clockwise)
+{
+    EarcutNode *last = NULL;
+
+    if (clockwise == (EarcutSignedArea(x, y, start, end) > 0))
+    {
+        for (int i = start; i < end; i++) last = EarcutInsertNode(ec, i, x[i], y[i], last);
+    }
+    else
+    {
+        for (int i = end - 1; i >= start; i--) last = EarcutInsertNode(ec, i, x[i], y[i], last);
+    }
+
+    if (last != NULL && EarcutEquals(last, last->next))
+    {
+        EarcutRemoveNode(last);
+        last = last->next;
+    }
+    return last;
+}
+
+// Drop duplicate and collinear points between start and end
+inline EarcutNode *EarcutFilterPoints(EarcutNode *start, EarcutNode *end)
+{
+    if (start == NULL) return start;
+    if (end == NULL) end = start;
+
+    EarcutNode *p = start;
+    bool again;
+    do
+    {
+        again = false;
+        if (!p->steiner && (EarcutEquals(p, p->next) || EarcutArea(p->prev, p, p->next) == 0))
+        {
+            EarcutRemoveNode(p);
+            p = end = p->prev;
+            if (p == p->next) break;
+            again = true;
+        }
+        else p = p->next;
+    } while (again || p != end);
+
+    return end;
+}
+
+inline int EarcutZOrder(const Earcut *ec, double px, double py)
+{
+    int x = (int)((px - ec->minX)*ec->invSize);
+    int y = (int)((py - ec->minY)*ec->invSize);
+
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+
+    y = (y | (y << 8)) & 0x00FF00FF;
+    y = (y | (y << 4)) & 0x0F0F0F0F;
+    y = (y | (y << 2)) & 0x33333333;
+    y = (y | (y << 1)) & 0x55555555;
+
+    return x | (y << 1);
+}
+
+// Merge sort of the z-order list (Simon Tatham's linked list sort)
+inline EarcutNode *EarcutSortLinked(EarcutNode *list)
+{
+    int inSize = 1;
+    int numMerges;
+
+    do
+    {
+        EarcutNode *p = list;
+        EarcutNode *tail = NULL;
+        list = NULL;
+        numMerges = 0;
+
+        while (p != NULL)
+        {
+            numMerges++;
+            EarcutNode *q = p;
+            int pSize = 0;
+            for (int i = 0; i < inSize; i++)
+            {
+                pSize++;
+                q = q->nextZ;
+                if (q == NULL) break;
+            }
+            int qSize = inSize;
+
+            while (pSize > 0 || (qSize > 0 && q != NULL))
+            {
+                EarcutNode *e;
+                if (pSize != 0 && (qSize == 0 || q == NULL || p->z <= q->z))
+                {
+                    e = p;
+                    p = p->nextZ;
+                    pSize--;
+                }
+                else
+                {
+                    e = q;
+                    q = q->nextZ;
+                    qSize--;
+                }
+
+                if (tail != NULL) tail->nextZ = e;
+                else list = e;
+                e->prevZ = tail;
+                tail = e;
+            }
+            p = q;
+        }
+
+        tail->nextZ = NULL;
+        inSize *= 2;
+    } while (numMerges > 1);
+
+    return list;
+}
+
+inline void EarcutIndexCurve(Earcut *ec, EarcutNode *start)
+{
+    EarcutNode *p = start;
+    do
+    {
+        if (p->z == 0) p->z = EarcutZOrder(ec, p->x, p->y);
+        p->prevZ = p->prev;
+        p->nextZ = p->next;
+        p = p->next;
+    } while (p != start);
+
+    p->prevZ->nextZ = NULL;
+    p->prevZ = NULL;
+    EarcutSortLinked(p);
+}
+
+inline bool EarcutIsEar(const EarcutNode *ear)
+{
+    const EarcutNode *a = ear->prev, *b = ear, *c = ear->next;
+    if (EarcutArea(a, b, c) >= 0) return false;     // Reflex, can't be an ear
+
+    double x0 = fmin(a->x, fmin(b->x, c->x)), y0 = fmin(a->y, fmin(b->y, c->y));
+    double x1 = fmax(a->x, fmax(b->x, c->x)), y1 = fmax(a->y, fmax(b->y, c->y));
+
+    const EarcutNode *p = c->next;
+    while (p != a)
+    {
+        if (p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 &&
+            EarcutPointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+            EarcutArea(p->prev, p, p->next) >= 0) return false;
+        p = p->next;
+    }
+    return true;
+}
+
+inline bool EarcutIsEarHashed(const Earcut *ec, const EarcutNode *ear)
+{
+    const EarcutNode *a = ear->prev, *b = ear, *c = ear->next;
+    if (EarcutArea(a, b, c) >= 0) return false;
+
+    double x0 = fmin(a->x, fmin(b->x, c->x)), y0 = fmin(a->y, fmin(b->y, c->y));
+    double x1 = fmax(a->x, fmax(b->x, c->x)), y1 = fmax(a->y, fmax(b->y, c->y));
+
+    // Only points inside the triangle bbox can be in it, walk the z range both ways
+    int minZ = EarcutZOrder(ec, x0, y0);
+    int maxZ = EarcutZOrder(ec, x1, y1);
+
+    const EarcutNode *p = ear->prevZ;
+    const EarcutNode *n = ear->nextZ;
+
+#define EARCUT_BLOCKS(q) ((q)->x >= x0 && (q)->x <= x1 && (q)->y >= y0 && (q)->y <= y1 && (q) != a && (q) != c && \
+    EarcutPointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, (q)->x, (q)->y) && EarcutArea((q)->prev, (q), (q)->next) >= 0)
+
+    while (p != NULL && p->z >= minZ && n != NULL && n->z <= maxZ)
+    {
+        if (EARCUT_BLOCKS(p)) return false;
+        p = p->prevZ;
+        if (EARCUT_BLOCKS(n)) return false;
+        n = n->nextZ;
+    }
+    while (p != NULL && p->z >= minZ)
+    {
+        if (EARCUT_BLOCKS(p)) return false;
+        p = p->prevZ;
+    }
+    while (n != NULL && n->z <= maxZ)
+    {
+        if (EARCUT_BLOCKS(n)) return false;
+        n = n->nextZ;
+    }
+
+#undef EARCUT_BLOCKS
+
+    return true;
+}
+
+inline void EarcutEmit(Earcut *ec, const EarcutNode *a, const EarcutNode *b, const EarcutNode *c)
+{
+    ec->triangles->push_back((unsigned int)a->i);
+    ec->triangles->push_back((unsigned int)b->i);
+    ec->triangles->push_back((unsigned int)c->i);
+}
+
+inline bool EarcutLocallyInside(const EarcutNode *a, const EarcutNode *b)
+{
+    return (EarcutArea(a->prev, a, a->next) < 0) ?
+        EarcutArea(a, b, a->next) >= 0 && EarcutArea(a, a->prev, b) >= 0 :
+        EarcutArea(a, b, a->prev) < 0 || EarcutArea(a, a->next, b) < 0;
+}
+
+// Walk back through local self-intersections and clip them as triangles
+inline EarcutNode *EarcutCureLocalIntersections(Earcut *ec, EarcutNode *start)
+{
+    EarcutNode *p = start;
+    do
+    {
+        EarcutNode *a = p->prev, *b = p->next->next;
+
+        if (!EarcutEquals(a, b) && EarcutIntersects(a, p, p->next, b) && EarcutLocallyInside(a, b) && EarcutLocallyInside(b, a))
+        {
+            EarcutEmit(ec, a, p, b);
+            EarcutRemoveNode(p);
+            EarcutRemoveNode(p->next);
+            p = start = b;
+        }
+        p = p->next;
+    } while (p != start);
+
+    return EarcutFilterPoints(p, NULL);
+}
+
+inline bool EarcutIntersectsPolygon(const EarcutNode *a, const EarcutNode *b)
+{
+    const EarcutNode *p = a;
+    do
+    {
+        if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i && EarcutIntersects(p, p->next, a, b)) return true;
+        p = p->next;
+    } while (p != a);
+    return false;
+}
+
+inline bool EarcutMiddleInside(const EarcutNode *a, const EarcutNode *b)
+{
+    const EarcutNode *p = a;
+    bool inside = false;
+    double px = 0.5*(a->x + b->x);
+    double py = 0.5*(a->y + b->y);
+    do
+    {
+        if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+            (px < (p->next->x - p->x)*(py - p->y)/(p->next->y - p->y) + p->x)) inside = !inside;
+        p = p->next;
+    } while (p != a);
+    return inside;
+}
+
+inline bool EarcutIsValidDiagonal(const EarcutNode *a, const EarcutNode *b)
+{
+    return a->next->i != b->i && a->prev->i != b->i && !EarcutIntersectsPolygon(a, b) &&
+           ((EarcutLocallyInside(a, b) && EarcutLocallyInside(b, a) && EarcutMiddleInside(a, b) &&
+             (EarcutArea(a->prev, a, b->prev) != 0 || EarcutArea(a, b->prev, b) != 0)) ||
+            (EarcutEquals(a, b) && EarcutArea(a->prev, a, a->next) > 0 && EarcutArea(b->prev, b, b->next) > 0));
+}
+
+// Link a and b with a bridge, splitting the ring in two; returns the copy of b
+inline EarcutNode *EarcutSplitPolygon(Earcut *ec, EarcutNode *a, EarcutNode *b)
+{
+    EarcutNode na = { a->i, a->x, a->y, NULL, NULL, 0, NULL, NULL, false };
+    EarcutNode nb = { b->i, b->x, b->y, NULL, NULL, 0, NULL, NULL, false };
+    ec->nodes.push_back(na);
+    EarcutNode *a2 = &ec->nodes.back();
+    ec->nodes.push_back(nb);
+    EarcutNode *b2 = &ec->nodes.back();
+    EarcutNode *an = a->next;
+    EarcutNode *bp = b->prev;
+
+    a->next = b;
+    b->prev = a;
+    a2->next = an;
+    an->prev = a2;
+    b2->next = a2;
+    a2->prev = b2;
+    bp->next = b2;
+    b2->prev = bp;
+
+    return b2;
+}
+
+inline void EarcutLinked(Earcut *ec, EarcutNode *ear, int pass);
+
+// Last resort: split the ring along a valid diagonal and triangulate both halves
+inline void EarcutSplit(Earcut *ec, EarcutNode *start)
+{
+    EarcutNode *a = start;
+    do
+    {
+        EarcutNode *b = a->next->next;
+        while (b != a->prev)
+        {
+            if (a->i != b->i && EarcutIsValidDiagonal(a, b))
+            {
+                EarcutNode *c = EarcutSplitPolygon(ec, a, b);
+                a = EarcutFilterPoints(a, a->next);
+                c = EarcutFilterPoints(c, c->next);
+                EarcutLinked(ec, a, 0);
+                EarcutLinked(ec, c, 0);
+                return;
+            }
+            b = b->next;
+        }
+        a = a->next;
+    } while (a != start);
+}
+
+// Main ear slicing loop, later passes repair rings the plain pass got stuck on
+inline void EarcutLinked(Earcut *ec, EarcutNode *ear, int pass)
+{
+    if (ear == NULL) return;
+    if (pass == 0 && ec->invSize != 0.0) EarcutIndexCurve(ec, ear);
+
+    EarcutNode *stop = ear;
+
+    while (ear->prev != ear->next)
+    {
+        EarcutNode *prev = ear->prev;
+        EarcutNode *next = ear->next;
+
+        if ((ec->invSize != 0.0) ? EarcutIsEarHashed(ec, ear) : EarcutIsEar(ear))
+        {
+            EarcutEmit(ec, prev, ear, next);
+            EarcutRemoveNode(ear);
+            ear = next->next;
+            stop = next->next;
+            continue;
+        }
+
+        ear = next;
+
+        if (ear == stop)
+        {
+            if (pass == 0) EarcutLinked(ec, EarcutFilterPoints(ear, NULL), 1);
+            else if (pass == 1)
+            {
+                ear = EarcutCureLocalIntersections(ec, EarcutFilterPoints(ear, NULL));
+                EarcutLinked(ec, ear, 2);
+            }
+            else if (pass == 2) EarcutSplit(ec, ear);
+            break;
+        }
+    }
+}
+
+inline bool EarcutSectorContainsSector(const EarcutNode *m, const EarcutNode *p)
+{
+    return EarcutArea(m->prev, m, p->prev) < 0 && EarcutArea(p->next, m, m->next) < 0;
+}
+
+// Outer ring vertex that the hole's leftmost vertex can be connected to (David Eberly's algorithm)
+inline EarcutNode *EarcutFindHoleBridge(EarcutNode *hole, EarcutNode *outerNode)
+{
+    EarcutNode *p = outerNode;
+    double hx = hole->x;
+    double hy = hole->y;
+    double qx = -DBL_MAX;
+    EarcutNode *m = NULL;
+
+    // Closest segment left of the hole point on the horizontal ray
+    do
+    {
+        if (hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+        {
+            double x = p->x + (hy - p->y)*(p->next->x - p->x)/(p->next->y - p->y);
+            if (x <= hx && x > qx)
+            {
+                qx = x;
+                m = (p->x < p->next->x) ? p : p->next;
+                if (x == hx) return m;  // Hole touches the outer segment
+            }
+        }
+        p = p->next;
+    } while (p != outerNode);
+
+    if (m == NULL) return NULL;
+
+    // Reflex vertices inside the triangle (hole, ray hit, m) may block the bridge,
+    // take the one with the smallest angle to the ray
+    EarcutNode *stop = m;
+    double mx = m->x;
+    double my = m->y;
+    double tanMin = DBL_MAX;
+
+    p = m;
+    do
+    {
+        if (hx >= p->x && p->x >= mx && hx != p->x &&
+            EarcutPointInTriangle((hy < my) ? hx : qx, hy, mx, my, (hy < my) ? qx : hx, hy, p->x, p->y))
+        {
+            double tan = fabs(hy - p->y)/(hx - p->x);
+            if (EarcutLocallyInside(p, hole) &&
+                (tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && EarcutSectorContainsSector(m, p))))))
+            {
+                m = p;
+                tanMin = tan;
+            }
+        }
+        p = p->next;
+    } while (p != stop);
+
+    return m;
+}
+
+inline EarcutNode *EarcutGetLeftmost(EarcutNode *start)
+{
+    EarcutNode *p = start, *leftmost = start;
+    do
+    {
+        if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y)) leftmost = p;
+        p = p->next;
+    } while (p != start);
+    return leftmost;
+}
+
+inline EarcutNode *EarcutEliminateHoles(Earcut *ec, const double *x, const double *y, const RingRange *rings, int ringCount, EarcutNode *outerNode)
+{
+    std::vector<EarcutNode *> queue;
+
+    for (int r = 1; r < ringCount; r++)
+    {
+        EarcutNode *list = EarcutLinkedList(ec, x, y, rings[r].start, rings[r].end, false);
+        if (list == NULL) continue;
+        if (list == list->next) list->steiner = true;
+        queue.push_back(EarcutGetLeftmost(list));
+    }
+
+    std::sort(queue.begin(), queue.end(), [](const EarcutNode *a, const EarcutNode *b) {
+        return (a->x != b->x) ? a->x < b->x : a->y < b->y;
+    });
+
+    // Bridge holes from left to right
+    for (int i = 0; i < (int)queue.size(); i++)
+    {
+        EarcutNode *bridge = EarcutFindHoleBridge(queue[i], outerNode);
+        if (bridge == NULL) continue;
+
+        EarcutNode *bridgeReverse = EarcutSplitPolygon(ec, bridge, queue[i]);
+        EarcutFilterPoints(bridgeReverse, bridgeReverse->next);
+        outerNode = EarcutFilterPoints(bridge, bridge->next);
+    }
+
+    return outerNode;
+}
+
+// Triangulate rings[0] minus the holes rings[1..ringCount). Triangles are appended to
+// 'triangles' as indices into x/y.
+inline void EarcutRings(const double *x, const double *y, const RingRange *rings, int ringCount, std::vector<unsigned int> *triangles)
+{
+    if (ringCount <= 0) return;
+
+    Earcut ec;
+    ec.triangles = triangles;
+    ec.minX = 0.0;
+    ec.minY = 0.0;
+    ec.invSize = 0.0;
+
+    EarcutNode *outerNode = EarcutLinkedList(&ec, x, y, rings[0].start, rings[0].end, true);
+    if (outerNode == NULL || outerNode->next == outerNode->prev) return;
+
+    if (ringCount > 1) outerNode = EarcutEliminateHoles(&ec, x, y, rings, ringCount, outerNode);
+
+    int total = 0;
+    for (int r = 0; r < ringCount; r++) total += rings[r].end - rings[r].start;
+
+    if (total > EARCUT_HASH_THRESHOLD)
+    {
+        double minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+        for (int i = rings[0].start; i < rings[0].end; i++)
+        {
+            minX = fmin(minX, x[i]);
+            minY = fmin(minY, y[i]);
+            maxX = fmax(maxX, x[i]);
+            maxY = fmax(maxY, y[i]);
+        }
+        double size = fmax(maxX - minX, maxY - minY);
+        ec.minX = minX;
+        ec.minY = minY;
+        ec.invSize = (size != 0.0) ? 32767.0/size : 0.0;
+    }
+
+    EarcutLinked(&ec, outerNode, 0);
+}
+
+//------------------------------------------------------------------------------------
+// Polygon ring grouping
+//------------------------------------------------------------------------------------
+
+// Shoelace area of a ring, negative for clockwise rings (shapefile outer rings)
+inline double RingSignedArea(const double *x, const double *y, int start, int end)
+{
+    double sum = 0.0;
+    for (int i = start, j = end - 1; i < end; j = i++) sum += (x[j] - x[i])*(y[j] + y[i]);
+    return 0.5*sum;
+}
+
+// Split the parts of a polygon feature into outer rings followed by their holes.
+// Shapefile outer rings are clockwise; each hole joins the smallest outer ring that
+// contains its first vertex. groupStart[g]..groupStart[g + 1] index 'rings'.
+inline void FeatureRingGroups(const Layer &layer, int feature, std::vector<RingRange> *rings, std::vector<int> *groupStart)
+{
+    rings->clear();
+    groupStart->clear();
+
+    int firstPart = layer.featurePart[feature];
+    int partCount = layer.featurePart[feature + 1] - firstPart;
+    if (partCount <= 0) return;
+
+    std::vector<double> area(partCount);
+    std::vector<int> outers;
+    for (int p = 0; p < partCount; p++)
+    {
+        area[p] = RingSignedArea(layer.x.data(), layer.y.data(), layer.partStart[firstPart + p], layer.partStart[firstPart + p + 1]);
+        if (area[p] < 0.0) outers.push_back(p);
+    }
+
+    // No clockwise ring at all: badly wound data, treat every ring as an outer ring
+    if (outers.empty()) for (int p = 0; p < partCount; p++) outers.push_back(p);
+
+    std::vector<int> owner(partCount, -1);
+    for (int p = 0; p < partCount; p++)
+    {
+        if (area[p] < 0.0 || outers.size() == (size_t)partCount) continue;
+
+        int v = layer.partStart[firstPart + p];
+        double best = DBL_MAX;
+        for (int o = 0; o < (int)outers.size(); o++)
+        {
+            int start = layer.partStart[firstPart + outers[o]];
+            int count = layer.partStart[firstPart + outers[o] + 1] - start;
+            if (-area[outers[o]] < best && PointInRing(&layer.x[start], &layer.y[start], count, layer.x[v], layer.y[v]))
+            {
+                best = -area[outers[o]];
+                owner[p] = o;
+            }
+        }
+    }
+
+    for (int o = 0; o < (int)outers.size(); o++)
+    {
+        groupStart->push_back((int)rings->size());
+        RingRange outer = { layer.partStart[firstPart + outers[o]], layer.partStart[firstPart + outers[o] + 1] };
+        rings->push_back(outer);
+        for (int p = 0; p < partCount; p++)
+        {
+            if (owner[p] != o) continue;
+            RingRange hole = { layer.partStart[firstPart + p], layer.partStart[firstPart + p + 1] };
+            rings->push_back(hole);
+        }
+    }
+    groupStart->push_back((int)rings->size());
+}
+
+//------------------------------------------------------------------------------------
+// LayerFill - cached triangulation of every polygon feature of a layer
+//
+// Triangles index the layer's own x/y arrays and are wound counter-clockwise in map
+// coordinates (y up). Feature f owns indices [featureStart[f], featureStart[f + 1]).
+// The fill method is chosen per layer: ear clipping alone, or ear clipping flipped into
+// the constrained Delaunay triangulation (Delaunay.h) for large lakes and land polygons
+// whose slivers show in anti-aliasing and shading.
+//------------------------------------------------------------------------------------
+typedef enum {
+    FILL_EARCUT = 0,        // Ear clipping, fastest
+    FILL_DELAUNAY           // Constrained Delaunay, no slivers
+} FillMethod;
+
+typedef struct LayerFill {
+    std::vector<unsigned int> indices;
+    std::vector<int> featureStart;
+} LayerFill;
+
+// Fill method from a command line name: earcut or delaunay. Unknown names give earcut.
+inline FillMethod FillMethodFromName(const char *name)
+{
+    if (name != NULL && strcmp(name, "delaunay") == 0) return FILL_DELAUNAY;
+    return FILL_EARCUT;
+}
+
+inline void TriangulateFeature(const Layer &layer, int feature, std::vector<unsigned int> *indices, FillMethod method = FILL_EARCUT)
+{
+    std::vector<RingRange> rings;
+    std::vector<int> groupStart;
+    FeatureRingGroups(layer, feature, &rings, &groupStart);
+
+    for (int g = 0; g + 1 < (int)groupStart.size(); g++)
+    {
+        size_t first = indices->size();
+        EarcutRings(layer.x.data(), layer.y.data(), &rings[groupStart[g]], groupStart[g + 1] - groupStart[g], indices);
+
+        for (size_t t = first; t + 2 < indices->size(); t += 3)
+        {
+            unsigned int a = (*indices)[t], b = (*indices)[t + 1], c = (*indices)[t + 2];
+            if (Orient2D(layer.x[a], layer.y[a], layer.x[b], layer.y[b], layer.x[c], layer.y[c]) < 0.0)
+            {
+                (*indices)[t + 1] = c;
+                (*indices)[t + 2] = b;
+            }
+        }
+        if (method == FILL_DELAUNAY) DelaunayFlipTriangles(layer.x.data(), layer.y.data(), indices, first);
+    }
+}
+
+// Triangulate every feature once, meant to run at load time
+inline LayerFill BuildLayerFill(const Layer &layer, FillMethod method = FILL_EARCUT)
+{
+    LayerFill fill;
+    fill.featureStart.reserve(layer.featureCount + 1);
+    fill.featureStart.push_back(0);
+
+    for (int f = 0; f < layer.featureCount; f++)
+    {
+        if (IsPolygonType(layer.shapeType)) TriangulateFeature(layer, f, &fill.indices, method);
+        fill.featureStart.push_back((int)fill.indices.size());
+    }
+
+    return fill;
+}
+
+#endif // VECTORMAP_TRIANGULATOR_H
@@ -0,0 +1,453 @@
+#ifndef VECTORMAP_VALIDATE_H
+#define VECTORMAP_VALIDATE_H
+
+#include "shapefil.h"
+#include "Layer.h"
+#include "Geometry.h"
+#include "JobSystem.h"
+#include "SpatialSort.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+#define VALIDATE_FEATURES_PER_JOB 256   // Features repaired per job
+#define VALIDATE_MAX_SPLITS 4096        // Self-intersection splits per ring before giving up
+
+//------------------------------------------------------------------------------------
+// Validate - repair pass over a whole layer
+//
+// Every feature is repaired on its own, so the layer is cut into blocks on the
+// JobSystem. Parts lose consecutive duplicate points and vertices collinear with their
+// neighbours (rings also lose spikes) and rings are closed. A ring that crosses or
+// touches itself is split at the crossing (or the repeated vertex) into simple rings: a
+// sweep over the edges sorted by x finds the first crossing, the ring is cut in two and
+// both halves are checked again. Last comes the orientation rule of SHPRewindObject:
+// a ring inside an even number of the feature's other rings is an outer ring and
+// clockwise, otherwise a hole and counter-clockwise. Rings with fewer than three
+// distinct points (lines: two) are dropped. Feature numbering is kept, so the .dbf
+// still matches.
+//------------------------------------------------------------------------------------
+typedef struct ValidationStats {
+    int features;               // Features checked
+    int invalidFeatures;        // Features that needed any repair
+    int duplicatePoints;        // Consecutive repeated points removed
+    int collinearPoints;        // Collinear points and spikes removed
+    int unclosedRings;          // Rings that did not repeat their first point
+    int selfIntersections;      // Crossings and self-touching vertices split
+    int reversedRings;          // Rings rewound to the shapefile orientation
+    int droppedParts;           // Degenerate parts removed
+} ValidationStats;
+
+// One part as open coordinate lists, a ring does not repeat its first point
+typedef struct PartPoints {
+    std::vector<double> x;
+    std::vector<double> y;
+} PartPoints;
+
+inline ValidationStats EmptyValidationStats(void)
+{
+    ValidationStats stats = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    return stats;
+}
+
+inline void ValidationStatsAdd(ValidationStats *total, const ValidationStats &stats)
+{
+    total->features += stats.features;
+    total->invalidFeatures += stats.invalidFeatures;
+    total->duplicatePoints += stats.duplicatePoints;
+    total->collinearPoints += stats.collinearPoints;
+    total->unclosedRings += stats.unclosedRings;
+    total->selfIntersections += stats.selfIntersections;
+    total->reversedRings += stats.reversedRings;
+    total->droppedParts += stats.droppedParts;
+}
+
+inline int ValidationRepairCount(const ValidationStats &stats)
+{
+    return stats.duplicatePoints + stats.collinearPoints + stats.unclosedRings + stats.selfIntersections +
+           stats.reversedRings + stats.droppedParts;
+}
+
+// Drop consecutive duplicates, on a ring also the closing point and wrap-around duplicates
+inline void RemoveDuplicatePoints(PartPoints *part, bool ring, ValidationStats *stats)
+{
+    int n = (int)part->x.size(), kept = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (kept > 0 && part->x[i] == part->x[kept - 1] && part->y[i] == part->y[kept - 1]) continue;
+        part->x[kept] = part->x[i];
+        part->y[kept] = part->y[i];
+        kept++;
+    }
+    while (ring && kept > 1 && part->x[kept - 1] == part->x[0] && part->y[kept - 1] == part->y[0]) kept--;
+
+    stats->duplicatePoints += n - kept;
+    part->x.resize(kept);
+    part->y.resize(kept);
+}
+
+// Remove b from a-b-c when the three are collinear. On a ring this includes spikes (b
+// beyond c) and wraps around; on a line only points between their neighbours go.
+inline void RemoveCollinearPoints(PartPoints *part, bool ring, ValidationStats *stats)
+{
+    int n = (int)part->x.size();
+    if (n < 3) return;
+
+    std::vector<double> xs, ys;
+    xs.reserve(n);
+    ys.reserve(n);
+    for (int i = 0; i < n; i++)
+    {
+        xs.push_back(part->x[i]);
+        ys.push_back(part->y[i]);
+        // Each removal can expose a new collinear triple at the back of the stack
+        while (xs.size() >= 3)
+        {
+            size_t k = xs.size();
+            double ax = xs[k - 3], ay = ys[k - 3], bx = xs[k - 2], by = ys[k - 2], cx = xs[k - 1], cy = ys[k - 1];
+            if (Orient2D(ax, ay, bx, by, cx, cy) != 0.0) break;
+            if (!ring && !OnSegment(ax, ay, cx, cy, bx, by)) break;
+            xs.erase(xs.end() - 2);
+            ys.erase(ys.end() - 2);
+            if (xs[k - 3] == xs[k - 2] && ys[k - 3] == ys[k - 2]) { xs.pop_back(); ys.pop_back(); }
+        }
+    }
+
+    // Wrap-around triples: last-first-second and second-last-last-first
+    for (bool changed = ring; changed && xs.size() >= 3;)
+    {
+        changed = false;
+        size_t k = xs.size();
+        if (Orient2D(xs[k - 1], ys[k - 1], xs[0], ys[0], xs[1], ys[1]) == 0.0)
+        {
+            xs.erase(xs.begin());
+            ys.erase(ys.begin());
+            changed = true;
+        }
+        else if (Orient2D(xs[k - 2], ys[k - 2], xs[k - 1], ys[k - 1], xs[0], ys[0]) == 0.0)
+        {
+            xs.pop_back();
+            ys.pop_back();
+            changed = true;
+        }
+    }
+
+    stats->collinearPoints += n - (int)xs.size();
+    part->x.swap(xs);
+    part->y.swap(ys);
+}
+
+inline void CleanPart(PartPoints *part, bool ring, ValidationStats *stats)
+{
+    RemoveDuplicatePoints(part, ring, stats);
+    RemoveCollinearPoints(part, ring, stats);
+    RemoveDuplicatePoints(part, ring, stats);
+}
+
+// First self-intersection of an open ring: a repeated vertex (i < j, *px set to NAN) or a
+// proper crossing of edges i and j at (*px, *py). Returns false for a simple ring.
+inline bool FindRingSelfIntersection(const PartPoints &ring, int *ei, int *ej, double *px, double *py)
+{
+    int n = (int)ring.x.size();
+    if (n < 4) return false;
+
+    // Repeated vertices come out next to each other once sorted
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&ring](int a, int b) {
+        return (ring.x[a] < ring.x[b]) || (ring.x[a] == ring.x[b] && (ring.y[a] < ring.y[b] || (ring.y[a] == ring.y[b] && a < b)));
+    });
+    for (int k = 1; k < n; k++)
+    {
+        int a = order[k - 1], b = order[k];
+        if (ring.x[a] != ring.x[b] || ring.y[a] != ring.y[b]) continue;
+        *ei = a;
+        *ej = b;
+        *px = NAN;
+        *py = NAN;
+        return true;
+    }
+
+    // Sweep the edges by their left end, testing each against the active ones it overlaps in x
+    std::vector<int> edges(n);
+    for (int i = 0; i < n; i++) edges[i] = i;
+    std::sort(edges.begin(), edges.end(), [&ring, n](int a, int b) {
+        return fmin(ring.x[a], ring.x[(a + 1)%n]) < fmin(ring.x[b], ring.x[(b + 1)%n]);
+    });
+
+    std::vector<int> active;
+    for (int k = 0; k < n; k++)
+    {
+        int e = edges[k];
+        double ax = ring.x[e], ay = ring.y[e], bx = ring.x[(e + 1)%n], by = ring.y[(e + 1)%n];
+        double left = fmin(ax, bx);
+
+        int kept = 0;
+        for (int m = 0; m < (int)active.size(); m++)
+        {
+            int f = active[m];
+            double cx = ring.x[f], cy = ring.y[f], dx = ring.x[(f + 1)%n], dy = ring.y[(f + 1)%n];
+            if (fmax(cx, dx) < left) continue;
+            active[kept++] = f;
+
+            // Neighbouring edges share a vertex and cannot cross
+            int lo = (e < f) ? e : f, hi = (e < f) ? f : e;
+            if (hi - lo == 1 || (lo == 0 && hi == n - 1)) continue;
+
+            double o1 = Orient2D(ax, ay, bx, by, cx, cy), o2 = Orient2D(ax, ay, bx, by, dx, dy);
+            double o3 = Orient2D(cx, cy, dx, dy, ax, ay), o4 = Orient2D(cx, cy, dx, dy, bx, by);
+            if (!(((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)) && ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0)))) continue;
+
+            double t = o3/(o3 - o4);
+            *ei = lo;
+            *ej = hi;
+            *px = ax + t*(bx - ax);
+            *py = ay + t*(by - ay);
+            return true;
+        }
+        active.resize(kept);
+        active.push_back(e);
+    }
+
+    return false;
+}
+
+// Split an open ring into simple rings, appended to 'out'
+inline void SplitSelfIntersections(const PartPoints &ring, std::vector<PartPoints> *out, ValidationStats *stats)
+{
+    std::vector<PartPoints> work(1, ring);
+    int splits = 0;
+
+    while (!work.empty())
+    {
+        PartPoints current;
+        current.x.swap(work.back().x);
+        current.y.swap(work.back().y);
+        work.pop_back();
+
+        int i, j;
+        double px, py;
+        if ((int)current.x.size() < 3) { stats->droppedParts++; continue; }
+        if (splits >= VALIDATE_MAX_SPLITS || !FindRingSelfIntersection(current, &i, &j, &px, &py))
+        {
+            out->push_back(current);
+            continue;
+        }
+        splits++;
+        stats->selfIntersections++;
+
+        // Edge i runs i -> i + 1 and edge j runs j -> j + 1, each loop starts at the cut point
+        int n = (int)current.x.size();
+        PartPoints first, second;
+        bool crossing = !isnan(px);
+        if (crossing)
+        {
+            first.x.push_back(px); first.y.push_back(py);
+            second.x.push_back(px); second.y.push_back(py);
+        }
+        for (int k = i + 1; k <= j; k++) { first.x.push_back(current.x[k]); first.y.push_back(current.y[k]); }
+        for (int k = crossing ? j + 1 : j; k < n; k++) { second.x.push_back(current.x[k]); second.y.push_back(current.y[k]); }
+        for (int k = 0; k < (crossing ? i + 1 : i); k++) { second.x.push_back(current.x[k]); second.y.push_back(current.y[k]); }
+        if (!crossing)
+        {
+            // A repeated vertex i == j: first is i + 1 .. j, put the shared vertex in front
+            first.x.insert(first.x.begin(), current.x[i]);
+            first.y.insert(first.y.begin(), current.y[i]);
+            first.x.pop_back();
+            first.y.pop_back();
+        }
+
+        CleanPart(&first, true, stats);
+        CleanPart(&second, true, stats);
+        work.push_back(first);
+        work.push_back(second);
+    }
+}
+
+// Twice the signed area of an open ring, negative for clockwise
+inline double RingSignedArea(const PartPoints &ring)
+{
+    double area = 0.0;
+    int n = (int)ring.x.size();
+    for (int i = 0, j = n - 1; i < n; j = i++) area += (ring.x[j] - ring.x[i])*(ring.y[j] + ring.y[i]);
+    return area;
+}
+
+// Rewind open rings by nesting depth, sampled at the middle of each ring's first edge:
+// even depth is an outer ring (clockwise), odd a hole. Returns the rings reversed.
+inline int RewindRings(std::vector<PartPoints> *rings)
+{
+    int reversed = 0;
+    for (int r = 0; r < (int)rings->size(); r++)
+    {
+        PartPoints &ring = (*rings)[r];
+        double sx = 0.5*(ring.x[0] + ring.x[1]), sy = 0.5*(ring.y[0] + ring.y[1]);
+        int depth = 0;
+        for (int o = 0; o < (int)rings->size(); o++)
+        {
+            const PartPoints &other = (*rings)[o];
+            if (o != r && PointInRing(other.x.data(), other.y.data(), (int)other.x.size(), sx, sy)) depth++;
+        }
+        bool clockwise = RingSignedArea(ring) < 0.0;
+        if (clockwise != (depth%2 == 0))
+        {
+            std::reverse(ring.x.begin(), ring.x.end());
+            std::reverse(ring.y.begin(), ring.y.end());
+            reversed++;
+        }
+    }
+    return reversed;
+}
+
+// Repair one feature into 'parts' (rings closed again), 'stats' collects what was done
+inline void RepairFeature(const Layer &layer, int feature, std::vector<PartPoints> *parts, ValidationStats *stats)
+{
+    bool polygon = IsPolygonType(layer.shapeType);
+    bool line = IsLineType(layer.shapeType);
+    int before = ValidationRepairCount(*stats);
+    parts->clear();
+
+    for (int p = layer.featurePart[feature]; p < layer.featurePart[feature + 1]; p++)
+    {
+        PartPoints part;
+        part.x.assign(layer.x.begin() + layer.partStart[p], layer.x.begin() + layer.partStart[p + 1]);
+        part.y.assign(layer.y.begin() + layer.partStart[p], layer.y.begin() + layer.partStart[p + 1]);
+        if (!polygon && !line)
+        {
+            parts->push_back(part);
+            continue;
+        }
+
+        int n = (int)part.x.size();
+        if (polygon && n > 1 && part.x[0] == part.x[n - 1] && part.y[0] == part.y[n - 1])
+        {
+            part.x.pop_back();
+            part.y.pop_back();
+        }
+        else if (polygon && n > 0) stats->unclosedRings++;
+
+        CleanPart(&part, polygon, stats);
+        if ((int)part.x.size() < (polygon ? 3 : 2)) { stats->droppedParts++; continue; }
+
+        if (polygon) SplitSelfIntersections(part, parts, stats);
+        else parts->push_back(part);
+    }
+
+    if (polygon) stats->reversedRings += RewindRings(parts);
+
+    for (int r = 0; polygon && r < (int)parts->size(); r++)
+    {
+        (*parts)[r].x.push_back((*parts)[r].x[0]);
+        (*parts)[r].y.push_back((*parts)[r].y[0]);
+    }
+
+    stats->features++;
+    if (ValidationRepairCount(*stats) != before) stats->invalidFeatures++;
+}
+
+// Columnar layer from per-feature parts (rings already closed), feature i keeps index i
+inline Layer BuildLayerFromParts(int shapeType, const std::vector<std::vector<PartPoints>> &features, const std::map<std::string, std::vector<double>> &columns)
+{
+    Layer result;
+    result.shapeType = shapeType;
+    result.featureCount = (int)features.size();
+    result.bounds = EmptyBounds();
+    result.columns = columns;
+    result.featurePart.push_back(0);
+    result.partStart.push_back(0);
+    for (int f = 0; f < result.featureCount; f++)
+    {
+        Bounds b = EmptyBounds();
+        for (int p = 0; p < (int)features[f].size(); p++)
+        {
+            const PartPoints &part = features[f][p];
+            for (int v = 0; v < (int)part.x.size(); v++) BoundsExtend(&b, part.x[v], part.y[v]);
+            result.x.insert(result.x.end(), part.x.begin(), part.x.end());
+            result.y.insert(result.y.end(), part.y.begin(), part.y.end());
+            result.partStart.push_back((int)result.x.size());
+        }
+        result.featurePart.push_back((int)result.partStart.size() - 1);
+        result.featureBounds.push_back(b);
+        if (!BoundsIsEmpty(b)) BoundsMerge(&result.bounds, b);
+    }
+
+    return result;
+}
+
+// Repaired copy of 'layer' with the same features and columns, repaired on 'jobs' when given
+inline Layer RepairLayer(const Layer &layer, JobSystem *jobs, ValidationStats *stats)
+{
+    int count = layer.featureCount;
+    std::vector<std::vector<PartPoints>> repaired(count);
+    int blocks = (count + VALIDATE_FEATURES_PER_JOB - 1)/VALIDATE_FEATURES_PER_JOB;
+    std::vector<ValidationStats> blockStats(blocks, EmptyValidationStats());
+
+    auto body = [&](int first, int last) {
+        ValidationStats &local = blockStats[first/VALIDATE_FEATURES_PER_JOB];
+        for (int f = first; f < last; f++) RepairFeature(layer, f, &repaired[f], &local);
+    };
+    if (jobs != NULL) ParallelFor(jobs, count, VALIDATE_FEATURES_PER_JOB, body);
+    else for (int first = 0; first < count; first += VALIDATE_FEATURES_PER_JOB) body(first, std::min(first + VALIDATE_FEATURES_PER_JOB, count));
+
+    *stats = EmptyValidationStats();
+    for (int b = 0; b < blocks; b++) ValidationStatsAdd(stats, blockStats[b]);
+
+    return BuildLayerFromParts(layer.shapeType, repaired, layer.columns);
+}
+
+// Write a layer as 'target' (.shp/.shx), copying the .dbf, .prj and .cpg of 'source'.
+// Z and M are not kept by Layer and are written as 0; features without parts become NULL records.
+inline bool WriteLayerShapefile(const Layer &layer, const char *source, const char *target)
+{
+    std::string sourceBase(source, SHPGetLenWithoutExtension(source));
+    std::string targetBase(target, SHPGetLenWithoutExtension(target));
+    if (sourceBase == targetBase) return false;
+
+    SHPHandle hOut = SHPCreate(targetBase.c_str(), layer.shapeType);
+    if (hOut == NULL) return false;
+
+    bool ok = true;
+    for (int f = 0; ok && f < layer.featureCount; f++)
+    {
+        int firstPart = layer.featurePart[f], parts = layer.featurePart[f + 1] - firstPart;
+        int firstVertex = layer.partStart[firstPart], vertices = layer.partStart[firstPart + parts] - firstVertex;
+
+        SHPObject *obj = NULL;
+        if (vertices == 0) obj = SHPCreateSimpleObject(SHPT_NULL, 0, NULL, NULL, NULL);
+        else
+        {
+            std::vector<int> starts(parts);
+            for (int p = 0; p < parts; p++) starts[p] = layer.partStart[firstPart + p] - firstVertex;
+            obj = SHPCreateObject(layer.shapeType, -1, parts, starts.data(), NULL, vertices,
+                                  layer.x.data() + firstVertex, layer.y.data() + firstVertex, NULL, NULL);
+        }
+        if (obj == NULL || SHPWriteObject(hOut, -1, obj) != f) ok = false;
+        if (obj != NULL) SHPDestroyObject(obj);
+    }
+    SHPClose(hOut);
+
+    DBFHandle hDBF = DBFOpen(sourceBase.c_str(), "rb");
+    if (ok && hDBF != NULL)
+    {
+        DBFHandle hDBFOut = DBFCloneEmpty(hDBF, targetBase.c_str());
+        ok = (hDBFOut != NULL);
+        for (int i = 0; ok && i < DBFGetRecordCount(hDBF); i++)
+        {
+            const char *tuple = DBFReadTuple(hDBF, i);
+            if (tuple == NULL || !DBFWriteTuple(hDBFOut, i, tuple)) ok = false;
+        }
+        if (hDBFOut != NULL) DBFClose(hDBFOut);
+    }
+    if (hDBF != NULL) DBFClose(hDBF);
+
+    if (ok)
+    {
+        SpatialSortCopySidecar(sourceBase, targetBase, ".prj");
+        SpatialSortCopySidecar(sourceBase, targetBase, ".cpg");
+    }
+
+    return ok;
+}
+
+#endif // VECTORMAP_VALIDATE_H